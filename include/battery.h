@@ -0,0 +1,61 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include "platform.h"
+
+/**
+ * bike battery monitor. the 12 V battery goes through a resistor divider into BATTERY_PIN, read against the 32U4's
+ * internal 2.56 V (bandgap derived) reference, so the reading doesn't move with the regulator's output.
+ *
+ * sampling is rare, on a slow timer, so it doesn't keep the chip out of power-down, and each sample is a few
+ * conversions in adc noise reduction sleep (see hal_battery_read()). samples are skipped while the siren plays: the
+ * load pulls the battery down and the reading would be low. the samples are smoothed, and the level only changes
+ * after the voltage has crossed a threshold by BATTERY_HYSTERESIS_MV. under BATTERY_ABSENT_MV there's no battery on
+ * the divider (the board runs off usb on the bench), and the level stays BATTERY_OK.
+ *
+ * a level change posts EVENT_BATTERY, so main.cpp can switch power profiles: at BATTERY_LOW less gets done (rarer
+ * wake-ups and samples, shorter siren bursts, dimmer leds), at BATTERY_CRITICAL the least, to leave enough charge in
+ * the battery to start the bike.
+ */
+
+#define BATTERY_DIVIDER_TOP 100 // kohm, battery to BATTERY_PIN
+#define BATTERY_DIVIDER_BOTTOM 15 // kohm, BATTERY_PIN to ground. full scale is ~19.6 V
+#define BATTERY_REFERENCE_MV 2560
+#define BATTERY_LOW_MV 12200 // ~50% charge on a resting lead-acid battery
+#define BATTERY_CRITICAL_MV 11900 // ~25%, about what's needed to still crank the engine
+#define BATTERY_HYSTERESIS_MV 100
+#define BATTERY_ABSENT_MV 6000
+#define BATTERY_SMOOTHING_SHIFT 2 // each sample moves the smoothed voltage by 1/4 of the difference
+#define BATTERY_SAMPLE_INTERVAL 64000UL // ms, at BATTERY_OK. the power profile can stretch it
+
+enum battery_level_t : uint8_t {
+    BATTERY_OK,
+    BATTERY_LOW,
+    BATTERY_CRITICAL,
+    BATTERY_LEVEL_COUNT
+};
+
+/**
+ * takes the first sample and starts sampling every BATTERY_SAMPLE_INTERVAL. call once from setup(), after
+ * timers_init().
+ */
+void battery_init();
+
+/**
+ * changes the sample interval, in ms.
+ */
+void battery_set_interval(unsigned long interval);
+
+/**
+ * handles the sample timer's event, other events are ignored.
+ */
+void battery_handle(uint8_t event);
+
+/**
+ * smoothed battery voltage, in mV.
+ */
+uint16_t battery_mv();
+
+battery_level_t battery_level();
+
+#endif //BATTERY_H
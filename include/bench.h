@@ -0,0 +1,111 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "platform.h"
+#include "state_machine.h"
+
+/**
+ * on-target timing, built into env:bench only (-DBENCH). the led timer (timer3, see hal_led_timer_start()) is kept
+ * running at the cpu clock, extended to 32 bits by counting its overflows, so every figure is in cpu cycles (62.5 ns
+ * at 16 MHz). the led timer's interrupt costs a little of every loop pass it lands in.
+ *
+ * what's measured:
+ *  - loop time per state: one loop() pass, from its start until it goes back to sleep, filed under the state it
+ *    started in. min / mean / max.
+ *  - guard cost: every transition's guard evaluated BENCH_GUARD_REPS times against each combination of the switch
+ *    bits, minus the same loop around an empty call. taken when the report is printed.
+ *  - input to alarm latency: from the first switch edge of a burst (the wake interrupt) until the alarm reacts, by
+ *    entering ENTRY_DELAY_STATE or, where a siren starts straight from an edge, by siren_play() driving ALARM_PIN.
+ *    a histogram with BENCH_LATENCY_BIN_US wide bins, the last bin collects everything longer. the entry delay
+ *    itself (config.entry_delay, seconds by default) is deliberate and not part of it.
+ *  - entry delay: from entering ENTRY_DELAY_STATE until siren_play() drives ALARM_PIN, for the delays that run out.
+ *    count / min / max in ms, to hold against config.entry_delay.
+ *  - boot: cycles the fast boot path (boot.h) takes from the start of .init8 until the alarm flag is read and
+ *    ALARM_PIN driven, timed with timer3 before the arduino core takes it over, and for a latched alarm the us from
+ *    main() (timer0 starting) until the siren pattern starts. the C runtime's startup before .init8 (a copy of .data
+ *    and a clear of .bss, tens of us) isn't included. measured once per power on, the report doesn't reset them.
+ *
+ * console command B prints the report and starts over. the BENCH_* macros compile to nothing in the other envs.
+ */
+
+#define BENCH_GUARD_REPS 100
+#define BENCH_LATENCY_BINS 16
+#define BENCH_LATENCY_BIN_US 1000
+#define BENCH_EDGE_WINDOW_US 50000 // a reaction this long after the last edge burst isn't counted as one
+
+#ifdef BENCH
+
+#ifndef ARDUINO
+#error "BENCH needs the hardware timer, it only builds for the board"
+#endif
+
+#define BENCH_LOOP_BEGIN() bench_loop_begin()
+#define BENCH_LOOP_END() bench_loop_end()
+#define BENCH_EDGE() bench_edge()
+#define BENCH_SIREN_ON() bench_siren_on()
+#define BENCH_ENTRY_DELAY() bench_entry_delay()
+#define BENCH_TIMER_OVERFLOW() bench_timer_overflow()
+#define BENCH_BOOT_BEGIN() bench_boot_begin()
+#define BENCH_BOOT_END() bench_boot_end()
+
+/**
+ * starts the led timer for good and starts counting. call once from setup(), after leds_init() and before anything
+ * else is measured.
+ */
+void bench_init();
+
+/**
+ * cycles since bench_init(). wraps after ~268 s, differences stay correct across that.
+ */
+uint32_t bench_cycles();
+
+void bench_loop_begin();
+
+void bench_loop_end();
+
+/**
+ * switch edge. called from the wake interrupt.
+ */
+void bench_edge();
+
+/**
+ * ALARM_PIN has just been driven by a new siren pattern.
+ */
+void bench_siren_on();
+
+/**
+ * ENTRY_DELAY_STATE has just been entered.
+ */
+void bench_entry_delay();
+
+/**
+ * the led timer wrapped. called from its interrupt.
+ */
+void bench_timer_overflow();
+
+/**
+ * start and end of boot_early(). run before main(), so they can't rely on anything set up by init() or setup().
+ */
+void bench_boot_begin();
+
+void bench_boot_end();
+
+/**
+ * writes everything measured so far to Serial (blocking, that pass isn't counted) and resets the figures.
+ */
+void bench_report();
+
+#else
+
+#define BENCH_LOOP_BEGIN() do {} while (0)
+#define BENCH_LOOP_END() do {} while (0)
+#define BENCH_EDGE() do {} while (0)
+#define BENCH_SIREN_ON() do {} while (0)
+#define BENCH_ENTRY_DELAY() do {} while (0)
+#define BENCH_TIMER_OVERFLOW() do {} while (0)
+#define BENCH_BOOT_BEGIN() do {} while (0)
+#define BENCH_BOOT_END() do {} while (0)
+
+#endif
+
+#endif //BENCH_H
@@ -0,0 +1,47 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "platform.h"
+
+/**
+ * fast boot path for a latched alarm. if the power was cut while the alarm was going off (or counting down to it),
+ * the siren has to come back as soon as the power does, not once setup() has brought up usb, Serial and everything
+ * else.
+ *
+ * on the board boot_early() runs from the .init8 section, i.e. straight after the C runtime has set up RAM and before
+ * main(), the arduino core's init() and the usb stack. it reads the persisted value (persist_init()) and, if the alarm
+ * flag is set, drives ALARM_PIN high. the pin stays high until the state machine goes from START_STATE to
+ * ALARM_TRIGGERED_STATE and the siren pattern takes over. the fuses' start-up delay comes before any of this and
+ * isn't something firmware can shorten.
+ *
+ * the reset cause is read (and the watchdog stopped) even earlier, in .init3. a brown-out or a watchdog reset
+ * (watchdog.h) means the chip was running a moment ago, so setup() goes straight back to the state the alarm was in,
+ * see boot_resumed(). the stock caterina bootloader clears the reset flags before it starts the sketch, and after a
+ * brown-out waits 8 s for an upload first, so this needs the sketch flashed without it (over ISP); behind caterina
+ * every reset reads as a power-on and goes through START_STATE as before.
+ *
+ * env:bench times the path (see bench.h).
+ */
+
+/**
+ * reads the persisted state and drives ALARM_PIN for a latched alarm. runs by itself before main() on the board; the
+ * native build calls it from its power-on, ahead of setup().
+ */
+void boot_early();
+
+/**
+ * true if boot_early() found the alarm latched and is holding ALARM_PIN high.
+ */
+bool boot_alarm_latched();
+
+/**
+ * why the chip last reset, HAL_RESET_* bits (see hal.h). 0 behind a bootloader that clears them.
+ */
+uint8_t boot_reset_cause();
+
+/**
+ * true after a brown-out or watchdog reset, where the alarm picks up where it was instead of starting over.
+ */
+bool boot_resumed();
+
+#endif //BOOT_H
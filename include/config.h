@@ -0,0 +1,89 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "platform.h"
+
+/**
+ * settings that can be changed over the serial console (see console.h) without reflashing. config_init() loads them
+ * from the EEPROM_CONFIG area once at boot; after that everything reads the config struct directly, the same as it
+ * would a #define, so nothing on the hot path parses or checks anything.
+ *
+ * EEPROM block: [version][payload length][payload: the packed struct][crc8 over everything before it]. the area is
+ * written only when the settings are saved, so it stays out of persist.h's wear-levelled ring.
+ *   - bad crc (blank EEPROM, a torn write) or a different CONFIG_VERSION: everything is the default.
+ *   - same version, shorter payload (saved by older firmware): the stored fields are kept, newer ones are defaulted.
+ * so new fields go on the end of config_t, with a row in the settings table in config.cpp. changing the meaning or
+ * order of existing ones bumps CONFIG_VERSION.
+ *
+ * the pin mapping stays in pins.h: the pins are compiled into the FastPin accessors and tied to the INT0/INT1 wake
+ * interrupts and the timer PWM outputs, so it can't move at runtime.
+ */
+
+#define CONFIG_VERSION 1
+
+#define CONFIG_NAME_MAX 18 // longest setting name, with its terminator
+
+// defaults.
+#define CONFIG_EXIT_DELAY 20 // seconds between the button release and the alarm arming
+#define CONFIG_ENTRY_DELAY 15 // seconds between a trigger and the siren, for the owner to disarm
+#define CONFIG_REARM_TIME 120 // seconds after a trigger until the alarm can re-arm itself. 2 min
+
+// values of config.siren_pattern, see siren.h for the patterns.
+enum siren_choice_t : uint8_t {
+    SIREN_CHOICE_BEEP,
+    SIREN_CHOICE_ESCALATING,
+    SIREN_CHOICE_WARBLE,
+    SIREN_CHOICE_COUNT
+};
+
+struct __attribute__((packed)) config_t {
+    uint16_t exit_delay; // s
+    uint16_t entry_delay; // s
+    uint16_t rearm_time; // s
+    uint8_t debounce_samples; // see DEBOUNCE_SAMPLES, which is the default and the maximum
+    uint8_t siren_pattern; // siren_choice_t
+    uint16_t tamper_score; // see IMU_TAMPER_SCORE
+    uint8_t sensors; // optional sensors fitted: bit 0 seat, 1 side panel, 2 steering lock (DEBOUNCE_SENSORS >> shift)
+};
+
+extern config_t config;
+
+/**
+ * loads the settings, or the defaults. call once at boot, before anything that reads them.
+ */
+void config_init();
+
+/**
+ * writes the config struct to EEPROM. blocks for a few ms per changed byte.
+ */
+void config_save();
+
+/**
+ * sets every field back to its default. doesn't save.
+ */
+void config_defaults();
+
+/**
+ * number of settings, and so of valid indexes for the functions below.
+ */
+uint8_t config_count();
+
+/**
+ * index of the setting called name, or -1.
+ */
+int8_t config_find(const char *name);
+
+/**
+ * copies the name of setting index into buffer, which must hold CONFIG_NAME_MAX bytes.
+ */
+void config_name(uint8_t index, char *buffer);
+
+uint16_t config_get(uint8_t index);
+
+/**
+ * changes setting index in RAM, which takes effect straight away. false, and no change, if value is out of range.
+ * see config_save() to keep it.
+ */
+bool config_set(uint8_t index, uint16_t value);
+
+#endif //CONFIG_H
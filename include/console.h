@@ -0,0 +1,29 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#define CONSOLE_LINE_MAX 32 // longest command line, with its terminator. longer ones are thrown away
+
+/**
+ * commands from the usb serial port, one per line (ended by \n or \r), words separated by spaces:
+ *   T                    dump the transition trace, as protocol frames (see protocol.h, tools/trace_decode.py)
+ *   B                    print the benchmark report and start over (env:bench only, see bench.h)
+ *   get                  list every setting (see config.h) and its value
+ *   get <name>           print one setting
+ *   set <name> <value>   change a setting. takes effect straight away, but is lost at the next reset unless saved
+ *   save                 write the settings to EEPROM
+ *   defaults             put every setting back to its default. doesn't save
+ * replies go out through the log buffer (see log.h). binary protocol frames (protocol.h) can come in between lines,
+ * they're handed over to the protocol as they arrive.
+ */
+
+/**
+ * resets the command reader. call once from setup().
+ */
+void console_init();
+
+/**
+ * handles whatever has arrived on Serial, lines and protocol frames. never waits for input. call from loop().
+ */
+void console_poll();
+
+#endif //CONSOLE_H
@@ -0,0 +1,69 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include "platform.h"
+#include "pins.h"
+
+/**
+ * every switch debounced in parallel, one bit per switch. each system tick hal_inputs_read() takes all of them in one
+ * go (one read per port) and a vertical counter, the bit-sliced version of a per-switch counter, moves the whole byte
+ * along at once: a switch's debounced bit only changes after it has read the other way for config.debounce_samples
+ * ticks in a row. whatever the number of switches, a tick costs the same handful of instructions.
+ */
+
+/**
+ * number of consecutive samples (one per ~1 ms timer tick) a switch has to agree on before its debounced state
+ * changes. at most 8, the most the 3 bit counter can count to. this is the default, and the limit, for
+ * config.debounce_samples, which is what the debouncer actually uses (see config.h).
+ */
+#define DEBOUNCE_SAMPLES 8
+
+// bits in debounced_inputs, and in hal_inputs_read(). a set bit means the switch is closed. these are the transition
+// guards' bits too (see states.h), so bits 2, 6 and 7 are left for the ones derived from other state.
+#define DEBOUNCE_BUTTON _BV(0) // button pressed
+#define DEBOUNCE_KICKSTAND _BV(1) // kickstand down
+#define DEBOUNCE_SEAT _BV(3) // someone on the seat
+#define DEBOUNCE_SIDE_PANEL _BV(4) // side panel in place
+#define DEBOUNCE_STEERING_LOCK _BV(5) // steering lock engaged (reed switch)
+
+// the optional sensors, in config.sensors order from DEBOUNCE_SENSORS_SHIFT up. they wake the chip through pin
+// change interrupts instead of INT0 / INT1.
+#define DEBOUNCE_SENSORS_SHIFT 3
+#define DEBOUNCE_SENSORS (DEBOUNCE_SEAT | DEBOUNCE_SIDE_PANEL | DEBOUNCE_STEERING_LOCK)
+
+#define DEBOUNCE_ALL (DEBOUNCE_BUTTON | DEBOUNCE_KICKSTAND | DEBOUNCE_SENSORS)
+
+/**
+ * debounced state of every input, updated from the system tick. every change posts EVENT_INPUT.
+ */
+extern volatile uint8_t debounced_inputs;
+
+/**
+ * seeds the debouncer from the current pin values. pins must already be configured, and the config loaded
+ * (config_init()). sampling starts with the system tick, see timers_init().
+ */
+void debounce_init();
+
+/**
+ * takes one sample of every input. runs from the system tick (timers_tick()).
+ */
+void debounce_tick();
+
+/**
+ * true when no input is part way through a change, i.e. nothing is bouncing.
+ */
+bool debounce_settled();
+
+/**
+ * maps an input pin to its bit in debounced_inputs.
+ */
+constexpr uint8_t debounce_mask(uint8_t pin) {
+    return pin == BUTTON_PIN ? DEBOUNCE_BUTTON
+           : pin == KICKSTAND_PIN ? DEBOUNCE_KICKSTAND
+           : pin == SEAT_PIN ? DEBOUNCE_SEAT
+           : pin == SIDE_PANEL_PIN ? DEBOUNCE_SIDE_PANEL
+           : pin == STEERING_LOCK_PIN ? DEBOUNCE_STEERING_LOCK
+           : 0;
+}
+
+#endif //DEBOUNCE_H
@@ -0,0 +1,26 @@
+#ifndef EEPROM_LAYOUT_H
+#define EEPROM_LAYOUT_H
+
+/**
+ * where everything lives in the 32U4's 1 KB of EEPROM. keep areas from overlapping when adding new ones.
+ */
+
+// alarm-state ring buffer, see persist.h. PERSIST_RECORDS records of PERSIST_RECORD_SIZE bytes.
+#define EEPROM_PERSIST_START 0x000
+#define EEPROM_PERSIST_END 0x100
+
+// copy of the transition trace, see trace.h.
+#define EEPROM_TRACE_START 0x100
+#define EEPROM_TRACE_END 0x200
+
+// settings, see config.h.
+#define EEPROM_CONFIG_START 0x200
+#define EEPROM_CONFIG_END 0x240
+
+// usage counters, two alternating copies. see stats.h.
+#define EEPROM_STATS_START 0x240
+#define EEPROM_STATS_END 0x280
+
+#define EEPROM_SIZE 0x400
+
+#endif //EEPROM_LAYOUT_H
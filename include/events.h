@@ -0,0 +1,44 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "platform.h"
+
+/**
+ * single byte events, queued from interrupts (debouncer, timers, IMU) and the main loop. the state machine only runs when
+ * one of these arrives; the rest of the time the cpu sleeps.
+ */
+
+#define EVENT_QUEUE_SIZE 16 // must be a power of two
+
+#define EVENT_INPUT 1 // the debounced inputs changed
+#define EVENT_STATE_ENTERED 2 // the state machine entered a new state, so its guards need a first look
+#define EVENT_MOTION 3 // the IMU's interrupt line went active, see imu.h
+#define EVENT_BATTERY 4 // the battery level changed, see battery.h
+#define EVENT_TIMER_BASE 0x10 // a timer expired. the timer id is added on top, see EVENT_TIMER()
+
+#define EVENT_SLOW_TIMER_BASE 0x20 // a slow timer expired, see timers.h
+
+#define EVENT_TIMER(id) (EVENT_TIMER_BASE + (id))
+#define EVENT_SLOW_TIMER(id) (EVENT_SLOW_TIMER_BASE + (id))
+
+/**
+ * number of events dropped because the queue was full.
+ */
+extern uint8_t event_overflows;
+
+/**
+ * queues an event. safe to call from interrupts. returns false (and drops the event) if the queue is full.
+ */
+bool event_post(uint8_t event);
+
+/**
+ * takes the oldest event off the queue. returns false if there was none.
+ */
+bool event_pop(uint8_t *event);
+
+/**
+ * true if there are queued events. call with interrupts disabled to make a sleep decision race free.
+ */
+bool events_pending();
+
+#endif //EVENTS_H
@@ -0,0 +1,95 @@
+#ifndef FAST_PIN_H
+#define FAST_PIN_H
+
+#include "Arduino.h"
+
+/**
+ * compile time pin -> port register mapping, so reads and writes turn into single in/sbi/cbi instructions instead of
+ * going through digitalRead()/digitalWrite()'s lookup tables.
+ *
+ * each port's PINx, DDRx and PORTx registers are consecutive, so a pin is described by the data space address of its
+ * PINx register and its bit number.
+ */
+namespace fast_pin {
+
+#if defined(ARDUINO_AVR_MICRO) || defined(ARDUINO_AVR_LEONARDO)
+
+    // data space addresses of PINB..PINF on the ATmega32U4.
+    constexpr uint8_t PORT_B = 0x23;
+    constexpr uint8_t PORT_C = 0x26;
+    constexpr uint8_t PORT_D = 0x29;
+    constexpr uint8_t PORT_E = 0x2C;
+    constexpr uint8_t PORT_F = 0x2F;
+
+    // same numbering as the arduino core's variant for the micro. D0-D13, then the SPI / RX led pins and A0-A5.
+    constexpr uint8_t PIN_PORTS[] = {
+            PORT_D, PORT_D, PORT_D, PORT_D, PORT_D, PORT_C, PORT_D, PORT_E, // D0-D7
+            PORT_B, PORT_B, PORT_B, PORT_B, PORT_D, PORT_C,                 // D8-D13
+            PORT_B, PORT_B, PORT_B, PORT_B,                                 // D14-D17 (MISO, SCK, MOSI, RXLED)
+            PORT_F, PORT_F, PORT_F, PORT_F, PORT_F, PORT_F,                 // A0-A5
+    };
+    constexpr uint8_t PIN_BITS[] = {
+            2, 3, 1, 0, 4, 6, 7, 6,
+            4, 5, 6, 7, 6, 7,
+            3, 1, 2, 0,
+            7, 6, 5, 4, 1, 0,
+    };
+
+#else
+#error "fast_pin.h has no pin mapping for this board"
+#endif
+
+    constexpr uint8_t PIN_COUNT = sizeof(PIN_BITS);
+
+} // namespace fast_pin
+
+template<uint8_t pin>
+struct FastPin {
+    static_assert(pin < fast_pin::PIN_COUNT, "pin has no port mapping on this board");
+
+    static constexpr uint8_t pin_address = fast_pin::PIN_PORTS[pin];
+    static constexpr uint8_t ddr_address = pin_address + 1;
+    static constexpr uint8_t port_address = pin_address + 2;
+    static constexpr uint8_t mask = _BV(fast_pin::PIN_BITS[pin]);
+
+    static inline void output() __attribute__((always_inline)) {
+        _SFR_MEM8(ddr_address) |= mask;
+    }
+
+    static inline void input() __attribute__((always_inline)) {
+        _SFR_MEM8(ddr_address) &= ~mask;
+        _SFR_MEM8(port_address) &= ~mask;
+    }
+
+    static inline void input_pullup() __attribute__((always_inline)) {
+        _SFR_MEM8(ddr_address) &= ~mask;
+        _SFR_MEM8(port_address) |= mask;
+    }
+
+    static inline bool read() __attribute__((always_inline)) {
+        return _SFR_MEM8(pin_address) & mask;
+    }
+
+    static inline void high() __attribute__((always_inline)) {
+        _SFR_MEM8(port_address) |= mask;
+    }
+
+    static inline void low() __attribute__((always_inline)) {
+        _SFR_MEM8(port_address) &= ~mask;
+    }
+
+    static inline void write(bool value) __attribute__((always_inline)) {
+        if (value) {
+            high();
+        } else {
+            low();
+        }
+    }
+
+    // writing a 1 to PINx flips the output latch on the 32U4.
+    static inline void toggle() __attribute__((always_inline)) {
+        _SFR_MEM8(pin_address) = mask;
+    }
+};
+
+#endif //FAST_PIN_H
@@ -0,0 +1,173 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include "platform.h"
+
+/**
+ * everything the firmware needs from the hardware: time, the switches, ALARM_PIN and the siren timer, the leds,
+ * sleep, the usb serial port and the EEPROM. the rest of the code only talks to the chip through here, so it builds
+ * for the host too (env:native, see src/native), where the same calls run against simulated pins and virtual time.
+ *
+ * on the board every call is an inline wrapper (hal_avr.h) around the register access it replaced, so this layer
+ * costs nothing there. the bit-banged i2c bus is the exception, it lives in src/avr.
+ *
+ * interrupts: the system tick's and the siren's interrupt handlers stay with their modules and call timers_tick() /
+ * siren_tick(). the native hal calls the same functions from its virtual timers.
+ */
+
+#ifdef ARDUINO
+#define HAL_API static inline
+#else
+#define HAL_API
+#endif
+
+// time. millis() and micros() from timer0, which stops in power-down sleep.
+HAL_API unsigned long hal_millis();
+HAL_API unsigned long hal_micros();
+
+/**
+ * switches, pullups on. hal_inputs_read() samples all of them at once, a set bit (DEBOUNCE_* in debounce.h) for each
+ * closed one.
+ */
+HAL_API void hal_inputs_init();
+HAL_API uint8_t hal_inputs_read();
+
+// ALARM_PIN, output, driven by the siren.
+HAL_API void hal_alarm_init();
+HAL_API void hal_alarm_write(bool high);
+HAL_API void hal_alarm_toggle();
+
+/**
+ * siren timer (timer1): 4 us ticks, calls siren_tick() every period ticks while running. hal_siren_timer_period()
+ * sets the period, taking effect from the next tick on; start() starts counting from 0.
+ */
+HAL_API void hal_siren_timer_init();
+HAL_API void hal_siren_timer_period(uint16_t period);
+HAL_API void hal_siren_timer_start();
+HAL_API void hal_siren_timer_stop();
+HAL_API bool hal_siren_timer_running();
+
+// system tick: calls timers_tick() every TIMER_TICK_US, off the millis() timer.
+HAL_API void hal_tick_start();
+
+/**
+ * watchdog, in interrupt and reset mode: calls watchdog_tick() every TIMER_SLOW_TICK_MS (see watchdog.h). keeps
+ * running in power-down and wakes the chip from it. running the interrupt drops the hardware back to plain reset mode,
+ * so the next timeout resets the chip unless hal_watchdog_rearm() is called in between. hal_watchdog_reset() resets
+ * it within ~16 ms and doesn't return on the board.
+ */
+HAL_API void hal_watchdog_start();
+HAL_API void hal_watchdog_rearm();
+HAL_API void hal_watchdog_reset();
+
+// reset causes, the MCUSR bits.
+#define HAL_RESET_POWER_ON _BV(0)
+#define HAL_RESET_EXTERNAL _BV(1)
+#define HAL_RESET_BROWN_OUT _BV(2)
+#define HAL_RESET_WATCHDOG _BV(3)
+
+/**
+ * why the chip reset (HAL_RESET_* bits), clearing the flags and stopping the watchdog, which stays on with its
+ * shortest timeout after a watchdog reset. only the first call sees the flags, see boot_reset_cause().
+ */
+HAL_API uint8_t hal_reset_cause();
+
+/**
+ * status leds, 0-255 duty per colour, and the builtin led. red is timer3's OC3A and green timer4's OC4D. blue (pin 7)
+ * has no pwm output, so its in between levels are made by the led timer's interrupts (hal_led_soft_pwm()). 0 and 255
+ * drive the pins as plain outputs, which hold in power-down; anything in between needs the led timer running.
+ * hal_status_led() isn't safe against the led timer's interrupt, call it from there or with interrupts off.
+ */
+HAL_API void hal_leds_init();
+HAL_API void hal_status_led(uint8_t r, uint8_t g, uint8_t b);
+HAL_API void hal_builtin_led(uint8_t level);
+
+/**
+ * led timer (timer3 in fast pwm mode, counting the cpu clock up to 0xFFFF): calls leds_tick() every LED_TICK_US while
+ * running. start() leaves a running timer alone, so the count stays continuous for bench.h.
+ */
+HAL_API void hal_led_timer_start();
+HAL_API void hal_led_timer_stop();
+
+// blue's software pwm edges, from the led timer's overflow (high) and compare (low) interrupts.
+HAL_API void hal_led_soft_pwm(bool high);
+
+/**
+ * sleep. on_edge is called from an interrupt on every change of a switch, and such a change wakes the chip up from
+ * any sleep mode. on the board the button and kickstand call it from INT0 / INT1, the sensors through power.cpp's pin
+ * change vector. hal_sleep() must be called with interrupts off (hal_irq_disable()); it turns them back on as
+ * it goes to sleep, so nothing can slip in between the caller's last check and the sleep. deep = power-down (only a
+ * switch edge wakes us), idle otherwise (any interrupt does).
+ */
+HAL_API void hal_wake_init(void (*on_edge)());
+HAL_API void hal_irq_disable();
+HAL_API void hal_irq_enable();
+HAL_API void hal_sleep(bool deep);
+
+/**
+ * cpu clock throttling: throttled divides the system clock by HAL_CLOCK_THROTTLE_DIV through the clock prescaler,
+ * and moves every timer that runs off a prescaler down by the same factor, so millis(), the system tick, the siren and
+ * the adc keep their rates. the led timer counts the cpu clock itself, the radio's uart baud rate comes from F_CPU
+ * and so do the bit-banged i2c bus's _delay_us() half bits, so hal_led_timer_start(), hal_radio_on() and every i2c
+ * transaction go back to full speed first: an imu batch read at 2 MHz would keep the cpu awake 8 times as long.
+ * loop() throttles again once it's idle.
+ */
+#define HAL_CLOCK_THROTTLE_DIV 8 // 2 MHz. the timers' /64 prescalers become /8, there's nothing between /8 and /1
+HAL_API void hal_clock_throttle(bool throttled);
+HAL_API bool hal_clock_throttled();
+
+/**
+ * battery sense: one reading of BATTERY_ADC_CHANNEL against the internal 2.56 V reference, 0-1023, averaged over a
+ * few conversions. the conversions run in adc noise reduction sleep, which stops the cpu and timer clocks for about
+ * half a ms. the adc is off again when this returns.
+ */
+HAL_API uint16_t hal_battery_read();
+
+// usb serial. connected = a host has the port open (dtr), so writes won't block.
+HAL_API void hal_serial_begin(unsigned long baud);
+
+/**
+ * usb power. vbus = there's 5 V on the usb connector, a host (or a charger) is plugged in; readable while detached.
+ * detach drops off the bus and stops the usb controller's clock, the pll and the pad regulator, which draw milliamps
+ * even in power-down. attach brings them back up (it waits about a ms for the pll to lock) and joins the bus again.
+ * configured = attached and enumerated by a host.
+ */
+HAL_API bool hal_usb_vbus();
+HAL_API void hal_usb_attach();
+HAL_API void hal_usb_detach();
+HAL_API bool hal_usb_attached();
+HAL_API bool hal_usb_configured();
+HAL_API bool hal_serial_connected();
+HAL_API int hal_serial_available();
+HAL_API int hal_serial_read();
+HAL_API int hal_serial_write_space();
+HAL_API void hal_serial_write(const uint8_t *data, uint8_t length);
+HAL_API void hal_serial_write(uint8_t byte);
+
+/**
+ * i2c bus of the optional IMU, bit-banged on IMU_SDA_PIN / IMU_SCL_PIN at ~100 kHz. reads auto-increment from reg.
+ * false if the device doesn't acknowledge.
+ */
+void hal_i2c_init();
+bool hal_i2c_write(uint8_t address, uint8_t reg, uint8_t value);
+bool hal_i2c_read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t length);
+
+// IMU interrupt line on IMU_INT_PIN. calls imu_irq() on every change, and wakes the chip from any sleep mode.
+HAL_API void hal_imu_irq_init();
+HAL_API bool hal_imu_irq_level();
+
+// optional radio module on the uart (Serial1, pins 0 and 1), powered through RADIO_ENABLE_PIN.
+HAL_API void hal_radio_on(unsigned long baud);
+HAL_API void hal_radio_off();
+HAL_API void hal_radio_write(const uint8_t *data, uint8_t length);
+
+// EEPROM, byte at a time. update only writes if the value differs; ready is false while a write is in progress.
+HAL_API uint8_t hal_eeprom_read(uint16_t address);
+HAL_API void hal_eeprom_update(uint16_t address, uint8_t value);
+HAL_API bool hal_eeprom_ready();
+
+#ifdef ARDUINO
+#include "hal_avr.h"
+#endif
+
+#endif //HAL_H
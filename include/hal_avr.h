@@ -0,0 +1,399 @@
+#ifndef HAL_AVR_H
+#define HAL_AVR_H
+
+/**
+ * hal.h on the ATmega32U4. only included from hal.h.
+ */
+
+#include "debounce.h"
+#include "fast_pin.h"
+#include "pins.h"
+
+#include <avr/eeprom.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#define HAL_SIREN_TIMER_PRESCALER (_BV(CS11) | _BV(CS10)) // /64, 4 us ticks at 16 MHz
+#define HAL_SIREN_TIMER_PRESCALER_THROTTLED _BV(CS11) // /8, the same 4 us at 2 MHz
+#define HAL_BATTERY_CONVERSIONS 4 // averaged, after one thrown away while the reference settles
+
+HAL_API unsigned long hal_millis() {
+    return millis();
+}
+
+HAL_API unsigned long hal_micros() {
+    return micros();
+}
+
+HAL_API void hal_inputs_init() {
+    FastPin<KICKSTAND_PIN>::input_pullup();
+    FastPin<BUTTON_PIN>::input_pullup();
+    FastPin<SEAT_PIN>::input_pullup();
+    FastPin<SIDE_PANEL_PIN>::input_pullup();
+    FastPin<STEERING_LOCK_PIN>::input_pullup();
+}
+
+/**
+ * bit of a closed switch on pin, from a read of its (inverted) PINx register.
+ */
+template<uint8_t pin>
+static inline uint8_t hal_closed_bit(uint8_t pins, uint8_t bit) __attribute__((always_inline));
+
+template<uint8_t pin>
+static inline uint8_t hal_closed_bit(uint8_t pins, uint8_t bit) {
+    return pins & FastPin<pin>::mask ? bit : 0;
+}
+
+HAL_API uint8_t hal_inputs_read() {
+    static_assert(FastPin<BUTTON_PIN>::pin_address == FastPin<KICKSTAND_PIN>::pin_address, "switches on one port");
+    static_assert(FastPin<SEAT_PIN>::pin_address == FastPin<SIDE_PANEL_PIN>::pin_address
+                  && FastPin<SEAT_PIN>::pin_address == FastPin<STEERING_LOCK_PIN>::pin_address,
+                  "sensors on one port");
+
+    // pullups, so a closed switch reads LOW. one read per port, then each bit moved to its place.
+    uint8_t switches = ~_SFR_MEM8(FastPin<BUTTON_PIN>::pin_address);
+    uint8_t sensors = ~_SFR_MEM8(FastPin<SEAT_PIN>::pin_address);
+    return hal_closed_bit<BUTTON_PIN>(switches, DEBOUNCE_BUTTON)
+           | hal_closed_bit<KICKSTAND_PIN>(switches, DEBOUNCE_KICKSTAND)
+           | hal_closed_bit<SEAT_PIN>(sensors, DEBOUNCE_SEAT)
+           | hal_closed_bit<SIDE_PANEL_PIN>(sensors, DEBOUNCE_SIDE_PANEL)
+           | hal_closed_bit<STEERING_LOCK_PIN>(sensors, DEBOUNCE_STEERING_LOCK);
+}
+
+HAL_API void hal_alarm_init() {
+    FastPin<ALARM_PIN>::low();
+    FastPin<ALARM_PIN>::output();
+}
+
+HAL_API void hal_alarm_write(bool high) {
+    FastPin<ALARM_PIN>::write(high);
+}
+
+HAL_API void hal_alarm_toggle() {
+    FastPin<ALARM_PIN>::toggle();
+}
+
+HAL_API void hal_siren_timer_init() {
+    // the arduino core puts timer1 in 8 bit pwm mode for analogWrite() on pins 9-11, which we don't use.
+    TCCR1B = 0;
+    TCCR1A = 0;
+    TIMSK1 = 0;
+}
+
+HAL_API void hal_siren_timer_period(uint16_t period) {
+    OCR1A = period - 1;
+}
+
+HAL_API void hal_siren_timer_start() {
+    TCNT1 = 0;
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 = _BV(OCIE1A);
+    TCCR1B = _BV(WGM12) | (CLKPR ? HAL_SIREN_TIMER_PRESCALER_THROTTLED : HAL_SIREN_TIMER_PRESCALER); // CTC on OCR1A
+}
+
+HAL_API void hal_siren_timer_stop() {
+    TCCR1B = 0;
+    TIMSK1 = 0;
+}
+
+HAL_API bool hal_siren_timer_running() {
+    return TCCR1B != 0;
+}
+
+HAL_API void hal_tick_start() {
+    // timer0 already runs millis() with a ~1 ms overflow. the compare B match gives us a second interrupt at the same
+    // rate for free. OC0B's pin output stays disconnected, since nothing calls analogWrite() on it.
+    OCR0B = 0x80;
+    TIFR0 = _BV(OCF0B);
+    TIMSK0 |= _BV(OCIE0B);
+}
+
+HAL_API void hal_watchdog_start() {
+    // interrupt and reset mode, 8 s. the timed sequence: WDCE | WDE, then the new value within 4 cycles.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        wdt_reset();
+        WDTCSR = _BV(WDCE) | _BV(WDE);
+        WDTCSR = _BV(WDIE) | _BV(WDE) | _BV(WDP3) | _BV(WDP0);
+    }
+}
+
+HAL_API void hal_watchdog_rearm() {
+    // WDIE alone doesn't need the timed sequence.
+    WDTCSR |= _BV(WDIE);
+}
+
+HAL_API void hal_watchdog_reset() {
+    cli();
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDE); // reset mode, 16 ms
+    for (;;) {
+    }
+}
+
+HAL_API uint8_t hal_reset_cause() {
+    uint8_t cause = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+    return cause;
+}
+
+HAL_API void hal_leds_init() {
+    FastPin<RED_PIN>::output();
+    FastPin<GREEN_PIN>::output();
+    FastPin<BLUE_PIN>::output();
+    pinMode(LED_BUILTIN, OUTPUT);
+
+    // timer3: fast pwm with ICR3 as top (mode 14), stopped until hal_led_timer_start(). replaces the core's 8 bit
+    // setup for analogWrite(). timer4 keeps the core's, PWM4D only has to be on for OC4D.
+    TCCR3B = 0;
+    TCCR3A = _BV(WGM31);
+    TCCR3B = _BV(WGM33) | _BV(WGM32);
+    ICR3 = 0xFFFF;
+    TIMSK3 = 0;
+    TCCR4C |= _BV(PWM4D);
+}
+
+HAL_API void hal_status_led(uint8_t r, uint8_t g, uint8_t b) {
+    if (r == 0 || r == 255) {
+        TCCR3A &= ~_BV(COM3A1);
+        FastPin<RED_PIN>::write(r);
+    } else {
+        OCR3A = r * 257;
+        TCCR3A |= _BV(COM3A1); // set at bottom, clear on match
+    }
+
+    if (g == 0 || g == 255) {
+        TCCR4C &= ~_BV(COM4D1);
+        FastPin<GREEN_PIN>::write(g);
+    } else {
+        TC4H = 0;
+        OCR4D = g;
+        TCCR4C |= _BV(COM4D1);
+    }
+
+    if (b == 0 || b == 255) {
+        TIMSK3 &= ~_BV(OCIE3B);
+        FastPin<BLUE_PIN>::write(b);
+    } else {
+        OCR3B = b * 257;
+        TIMSK3 |= _BV(OCIE3B);
+    }
+}
+
+HAL_API void hal_builtin_led(uint8_t level) {
+    analogWrite(LED_BUILTIN, level);
+}
+
+HAL_API void hal_led_timer_start() {
+    if (!(TCCR3B & _BV(CS30))) {
+        hal_clock_throttle(false); // LED_TICK_US is 65536 cycles at 16 MHz
+        TCNT3 = 0;
+        TIFR3 = _BV(TOV3) | _BV(OCF3B);
+        TIMSK3 |= _BV(TOIE3);
+        TCCR3B |= _BV(CS30); // no prescaler, 244 Hz pwm
+    }
+}
+
+HAL_API void hal_led_timer_stop() {
+    TCCR3B &= ~(_BV(CS32) | _BV(CS31) | _BV(CS30));
+    TIMSK3 = 0;
+}
+
+HAL_API void hal_led_soft_pwm(bool high) {
+    if (TIMSK3 & _BV(OCIE3B)) {
+        FastPin<BLUE_PIN>::write(high);
+    }
+}
+
+HAL_API void hal_wake_init(void (*on_edge)()) {
+    // INT0-INT3 are detected asynchronously on the 32U4, so edges on them can wake the chip from power-down.
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), on_edge, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(KICKSTAND_PIN), on_edge, CHANGE);
+
+    // the sensors have no INTx pins left, they're on port b's pin change interrupt (same bit numbers), whose vector
+    // is in power.cpp. asynchronous as well.
+    static_assert(FastPin<SEAT_PIN>::pin_address == fast_pin::PORT_B, "sensors must be on port b");
+    PCMSK0 |= FastPin<SEAT_PIN>::mask | FastPin<SIDE_PANEL_PIN>::mask | FastPin<STEERING_LOCK_PIN>::mask;
+    PCIFR = _BV(PCIF0);
+    PCICR |= _BV(PCIE0);
+}
+
+HAL_API void hal_irq_disable() {
+    cli();
+}
+
+HAL_API void hal_irq_enable() {
+    sei();
+}
+
+HAL_API void hal_sleep(bool deep) {
+    set_sleep_mode(deep ? SLEEP_MODE_PWR_DOWN : SLEEP_MODE_IDLE);
+
+    // the adc is only needed inside hal_battery_read(), and draws current if it is left on while sleeping.
+    uint8_t adcsra = ADCSRA;
+    ADCSRA &= ~_BV(ADEN);
+
+    // sei() takes effect after the next instruction, which is the sleep.
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+
+    ADCSRA = adcsra;
+}
+
+HAL_API bool hal_clock_throttled() {
+    return CLKPR != 0;
+}
+
+HAL_API void hal_clock_throttle(bool throttled) {
+    static_assert(HAL_CLOCK_THROTTLE_DIV == 8, "only /64 to /8 keeps the timers' rates");
+    if (throttled == hal_clock_throttled()) {
+        return;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // the clock select fields: timer0 (millis(), the system tick) and timer1 (the siren) go between /64 and /8,
+        // timer4 (green's pwm, the builtin led) has its own encoding. timer3 counts the cpu clock, see hal.h.
+        TCCR0B = (TCCR0B & ~0x07) | (throttled ? _BV(CS01) : _BV(CS01) | _BV(CS00));
+        if (TCCR1B & 0x07) {
+            TCCR1B = (TCCR1B & ~0x07) | (throttled ? HAL_SIREN_TIMER_PRESCALER_THROTTLED : HAL_SIREN_TIMER_PRESCALER);
+        }
+        if (TCCR4B & 0x0F) {
+            TCCR4B = (TCCR4B & ~0x0F) | (throttled ? _BV(CS42) : _BV(CS42) | _BV(CS41) | _BV(CS40));
+        }
+
+        // the timed sequence: CLKPCE, then the new value within 4 cycles.
+        CLKPR = _BV(CLKPCE);
+        CLKPR = throttled ? _BV(CLKPS1) | _BV(CLKPS0) : 0;
+    }
+}
+
+HAL_API uint16_t hal_battery_read() {
+    power_adc_enable();
+    DIDR0 |= _BV(ADC7D); // analog only, the digital input buffer would draw current at mid-rail voltages
+    ADMUX = _BV(REFS1) | _BV(REFS0) | BATTERY_ADC_CHANNEL;
+    ADCSRB = 0;
+    // /128 at 16 MHz, /16 throttled: 125 kHz either way
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | (hal_clock_throttled() ? 0 : _BV(ADPS1) | _BV(ADPS0));
+    set_sleep_mode(SLEEP_MODE_ADC);
+
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i <= HAL_BATTERY_CONVERSIONS; ++i) {
+        // going to sleep starts the conversion and its interrupt (ADC_vect, in battery.cpp) wakes us. anything else
+        // can wake us early too, then we sleep again; the conversion carries on meanwhile.
+        sleep_enable();
+        do {
+            sei();
+            sleep_cpu();
+        } while (ADCSRA & _BV(ADSC));
+        sleep_disable();
+        if (i != 0) {
+            sum += ADC;
+        }
+    }
+
+    ADCSRA = 0;
+    power_adc_disable();
+    return sum / HAL_BATTERY_CONVERSIONS;
+}
+
+HAL_API void hal_imu_irq_init() {
+    // pin change interrupts are asynchronous too, so the sensor can wake us from power-down.
+    FastPin<IMU_INT_PIN>::input();
+    PCMSK0 |= _BV(PCINT4);
+    PCIFR = _BV(PCIF0);
+    PCICR |= _BV(PCIE0);
+}
+
+HAL_API bool hal_imu_irq_level() {
+    return FastPin<IMU_INT_PIN>::read();
+}
+
+HAL_API void hal_serial_begin(unsigned long baud) {
+    Serial.begin(baud);
+}
+
+HAL_API bool hal_usb_vbus() {
+    // the vbus pad stays enabled (OTGPADE) while detached, with the controller's clock frozen.
+    return USBSTA & _BV(VBUS);
+}
+
+HAL_API void hal_usb_attach() {
+    USBDevice.attach(); // the core's: regulator, pll, unfreeze the clock, enable the pad, join the bus, interrupts
+}
+
+HAL_API void hal_usb_detach() {
+    UDIEN = 0;
+    UDCON |= _BV(DETACH);
+    USBCON = _BV(USBE) | _BV(FRZCLK) | _BV(OTGPADE);
+    PLLCSR = 0;
+    UHWCON &= ~_BV(UVREGE);
+}
+
+HAL_API bool hal_usb_attached() {
+    return !(USBCON & _BV(FRZCLK));
+}
+
+// the core only forgets its configuration on a bus reset, which an unplugged host never sends. so attached first.
+HAL_API bool hal_usb_configured() {
+    return hal_usb_attached() && USBDevice.configured();
+}
+
+// Serial's bool operator waits 10 ms, and writing to a port nobody has opened eventually blocks. dtr() is neither.
+HAL_API bool hal_serial_connected() {
+    return hal_usb_configured() && Serial.dtr();
+}
+
+HAL_API int hal_serial_available() {
+    return Serial.available();
+}
+
+HAL_API int hal_serial_read() {
+    return Serial.read();
+}
+
+HAL_API int hal_serial_write_space() {
+    return Serial.availableForWrite();
+}
+
+HAL_API void hal_serial_write(const uint8_t *data, uint8_t length) {
+    Serial.write(data, length);
+}
+
+HAL_API void hal_serial_write(uint8_t byte) {
+    Serial.write(byte);
+}
+
+HAL_API void hal_radio_on(unsigned long baud) {
+    hal_clock_throttle(false); // Serial1 works its baud rate out from F_CPU
+    FastPin<RADIO_ENABLE_PIN>::output();
+    FastPin<RADIO_ENABLE_PIN>::high();
+    Serial1.begin(baud);
+}
+
+HAL_API void hal_radio_off() {
+    // TX left high would feed the unpowered module through its input protection.
+    Serial1.end();
+    FastPin<1>::input();
+    FastPin<RADIO_ENABLE_PIN>::output();
+    FastPin<RADIO_ENABLE_PIN>::low();
+}
+
+HAL_API void hal_radio_write(const uint8_t *data, uint8_t length) {
+    Serial1.write(data, length);
+}
+
+HAL_API uint8_t hal_eeprom_read(uint16_t address) {
+    return eeprom_read_byte((const uint8_t *) address);
+}
+
+HAL_API void hal_eeprom_update(uint16_t address, uint8_t value) {
+    eeprom_update_byte((uint8_t *) address, value);
+}
+
+HAL_API bool hal_eeprom_ready() {
+    return eeprom_is_ready();
+}
+
+#endif //HAL_AVR_H
@@ -0,0 +1,75 @@
+#ifndef IMU_H
+#define IMU_H
+
+#include "platform.h"
+
+/**
+ * optional LIS3DH accelerometer as a second tamper trigger, for a bike lifted or pushed with the kickstand down. off
+ * unless built with -DIMU=1; with it on and no sensor answering, the alarm works as before.
+ *
+ * the mcu never polls the sensor. while the alarm is armed the sensor samples on its own into its 32 sample FIFO and
+ * uses its wake-on-motion comparator (high-passed, so gravity doesn't count) on INT1:
+ *  1. wake: the first movement raises INT1 and wakes us. the sensor switches to FIFO watermark interrupts.
+ *  2. batches: every IMU_FIFO_WATERMARK samples INT1 fires again and the whole FIFO is read in one go, then we go
+ *     back to sleep. each batch is scored as it is read (see motion.h).
+ *  3. IMU_TAMPER_BATCHES batches in a row with the running score at or above the threshold set the tamper flag
+ *     (INPUT_TAMPER). a batch scoring below IMU_STILL_SCORE goes back to 1.
+ *
+ * motion is ignored for IMU_SETTLE_TIME after arming, while the rider walks away.
+ */
+
+#ifndef IMU
+#define IMU 0
+#endif
+
+#define IMU_ADDRESS 0x18 // SA0 low
+#define IMU_SETTLE_TIME 5000 // ms after arming before motion counts
+#define IMU_WAKE_THRESHOLD 6 // wake-on-motion threshold, 16 mg steps at +-2 g
+#define IMU_WAKE_DURATION 2 // samples the threshold has to be exceeded for
+#define IMU_FIFO_WATERMARK 16 // samples per batch. at 50 Hz, one batch every 320 ms
+#define IMU_TAMPER_SCORE 320 // default config.tamper_score, threshold on the running motion score (MOTION_SCORE_ONE)
+#define IMU_STILL_SCORE 64 // a batch below this is the bike at rest
+#define IMU_TAMPER_BATCHES 2 // batches in a row over the threshold that count as tampering
+
+struct imu_sample_t {
+    int8_t x;
+    int8_t y;
+    int8_t z;
+};
+
+/**
+ * looks for the sensor and puts it in power-down. call once from setup().
+ */
+void imu_init();
+
+/**
+ * true if the sensor answered in imu_init().
+ */
+bool imu_present();
+
+/**
+ * starts watching for motion (after IMU_SETTLE_TIME), and clears the tamper flag.
+ */
+void imu_arm();
+
+/**
+ * stops watching and puts the sensor back in power-down.
+ */
+void imu_disarm();
+
+/**
+ * true once motion has been seen since imu_arm().
+ */
+bool imu_tampered();
+
+/**
+ * handles EVENT_MOTION and the IMU_SETTLE timer. other events are ignored.
+ */
+void imu_handle(uint8_t event);
+
+/**
+ * INT1 changed. runs from the pin change interrupt, which it shares with the optional sensors (see power.cpp).
+ */
+void imu_irq();
+
+#endif //IMU_H
@@ -0,0 +1,97 @@
+#ifndef LEDS_H
+#define LEDS_H
+
+#include "platform.h"
+
+/**
+ * status led engine. plays colour patterns from the led timer's interrupt (see hal_led_timer_start()), so fades and
+ * blinks go on while the cpu sleeps and the main loop has nothing to do.
+ *
+ * a pattern is a list of steps in PROGMEM, like a siren pattern: each step either jumps to its colour and holds it,
+ * or fades there from the previous colour, for a number of LED_TICK_US ticks. levels are perceptual, 0-255, and get
+ * squared into pwm duty on the way out, so a fade looks even and low levels go really dim.
+ *
+ * the led timer only runs while it is needed: while a pattern plays, or while a colour is set that isn't fully on or
+ * off on every channel. leds_active() tells power_sleep() so. a beacon (leds_beacon()) is for the armed state: it
+ * plays a short pattern every few seconds off a slow timer, and the chip goes back to power-down in between.
+ */
+
+#define LED_TICK_US 4096 // led timer overflow period: 65536 cycles at 16 MHz
+#define LED_BEACON_INTERVAL 8000 // ms, one slow timer tick
+
+#define LED_STEP_HOLD 0
+#define LED_STEP_FADE 1
+#define LED_ONCE 0xFF // repeat_from for a pattern that stops (and turns the leds off) after its last step
+
+struct led_step_t {
+    uint8_t mode;
+    uint16_t ticks; // at least 1
+    uint8_t colour[3]; // r, g, b
+};
+
+struct led_pattern_t {
+    const led_step_t *steps; // PROGMEM
+    uint8_t step_count;
+    uint8_t repeat_from; // after the last step, play continues from this step, or LED_ONCE
+};
+
+constexpr uint16_t led_ticks(uint32_t ms) {
+    return ms * 1000 < LED_TICK_US ? 1 : (ms * 1000 + LED_TICK_US / 2) / LED_TICK_US;
+}
+
+/**
+ * step that jumps to the colour and holds it for ms milliseconds. the colour is r, g, b (so RED etc. work too).
+ */
+#define LED_HOLD(ms, ...) {LED_STEP_HOLD, led_ticks(ms), {__VA_ARGS__}}
+
+/**
+ * step that fades from the previous colour to this one over ms milliseconds.
+ */
+#define LED_FADE(ms, ...) {LED_STEP_FADE, led_ticks(ms), {__VA_ARGS__}}
+
+extern const led_pattern_t LED_PATTERN_ARMED; // one dim red flash, ~80 ms: 1% duty as a beacon
+extern const led_pattern_t LED_PATTERN_BREATHE; // green, slowly in and out
+extern const led_pattern_t LED_PATTERN_COUNTDOWN; // red, blinking twice a second
+
+/**
+ * sets up the led pins and the led timer (stopped), leds off. call once from setup().
+ */
+void leds_init();
+
+/**
+ * solid colour. stops any pattern or beacon.
+ */
+void leds_set(uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * plays pattern (a PROGMEM led_pattern_t) from its first step, fading out of whatever is showing. stops any beacon.
+ */
+void leds_play(const led_pattern_t *pattern);
+
+/**
+ * plays pattern now and then every interval ms (rounded up to slow timer ticks), leds off in between. for short
+ * LED_ONCE patterns.
+ */
+void leds_beacon(const led_pattern_t *pattern, unsigned long interval);
+
+/**
+ * divides every level by 2^shift, to save power. 8 or more keeps the leds dark.
+ */
+void leds_set_dim(uint8_t shift);
+
+/**
+ * handles the beacon's timer event, other events are ignored.
+ */
+void leds_handle(uint8_t event);
+
+/**
+ * one led timer tick: steps the pattern. runs from the led timer interrupt.
+ */
+void leds_tick();
+
+/**
+ * true while the led timer has to run, so power-down is out.
+ */
+bool leds_active();
+
+#endif //LEDS_H
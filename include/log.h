@@ -0,0 +1,81 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "platform.h"
+
+/**
+ * logging without the heap and without blocking. format strings live in flash (PSTR), lines are formatted into a
+ * fixed ring buffer, and log_drain() hands the buffer to the usb serial port only as fast as it can take it. when no
+ * host is listening, or the buffer or the rate limit is full, new lines are dropped and counted instead.
+ *
+ * LOG_LEVEL (set it with -DLOG_LEVEL=... in build_flags) picks which LOG_* macros are compiled in at all. anything
+ * above it, format strings included, doesn't end up in the binary. LOG_LEVEL_NONE strips logging completely.
+ */
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_BUFFER_SIZE 128 // ring buffer size in bytes. must be a power of two.
+#define LOG_LINE_MAX 64 // longest line, including the newline. longer lines are cut short.
+#define LOG_BURST 16 // lines that can be logged back to back
+#define LOG_RATE_INTERVAL 50 // after a burst, one more line is allowed every this many ms
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_WARN(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+/**
+ * formats one line (printf style, fmt in PROGMEM) into the buffer and adds a newline. use the LOG_* macros instead of
+ * calling this directly.
+ */
+void log_printf_P(const char *fmt, ...);
+
+/**
+ * queues raw bytes (a protocol frame, see protocol.h) behind the lines already buffered. they go in whole or not at
+ * all: returns false, and counts nothing, if they don't fit. not rate limited, the caller paces itself.
+ */
+bool log_write(const uint8_t *data, uint8_t length);
+
+/**
+ * writes as much of the buffer to Serial as it can take without blocking. call from loop().
+ */
+void log_drain();
+
+/**
+ * true if there's buffered output waiting for log_drain().
+ */
+bool log_pending();
+
+/**
+ * number of lines dropped because the buffer or the rate limit was full.
+ */
+uint16_t log_dropped();
+
+#endif //LOG_H
@@ -0,0 +1,41 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "imu.h"
+
+/**
+ * streaming motion score for the IMU's FIFO batches, integer only and in constant memory: samples are folded into
+ * per-axis sums as they are read and never stored.
+ *
+ * a batch scores its variance plus its jerk, summed over the three axes, in 1/16 count units (a count is 16 mg):
+ *  - variance: (n * sum(x^2) - sum(x)^2) / n^2, how far the samples spread. zero for a bike at rest, whatever its
+ *    tilt, since gravity is constant.
+ *  - jerk: mean |x[i] - x[i-1]|, how fast they change. catches short, sharp movements that don't spread much.
+ * the running score follows the batch scores with a 1/2^MOTION_SCORE_SHIFT exponential average, so one bump counts
+ * for less than the same movement kept up.
+ */
+
+#define MOTION_SCORE_SHIFT 2
+#define MOTION_SCORE_ONE 16 // score of a spread / jerk of one count
+
+/**
+ * forgets everything, including the running score.
+ */
+void motion_reset();
+
+/**
+ * adds one sample to the current batch.
+ */
+void motion_add(const imu_sample_t &sample);
+
+/**
+ * closes the current batch and returns its score. the next sample starts a new one.
+ */
+uint16_t motion_end_batch();
+
+/**
+ * the running score, updated by motion_end_batch().
+ */
+uint16_t motion_score();
+
+#endif //MOTION_H
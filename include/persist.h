@@ -0,0 +1,53 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "platform.h"
+#include "eeprom_layout.h"
+#include "timers.h"
+
+/**
+ * wear-levelled storage for the one byte of alarm state that has to survive a power cut.
+ *
+ * every write goes to the next slot of a ring of 4 byte records (16 bit sequence number, value, crc8) spread over
+ * the EEPROM_PERSIST area, so each cell only sees 1 / PERSIST_RECORDS of the writes. the newest valid record wins at
+ * boot. the crc byte is written last, so a write torn by a power cut leaves the previous record in charge.
+ *
+ * writes only happen when the value actually changes, and non-urgent ones are held back for PERSIST_COALESCE_TIME ms
+ * so a value that flips back and forth (e.g. the alarm being silenced and immediately re-triggered) costs nothing.
+ */
+
+#define PERSIST_RECORD_SIZE 4
+#define PERSIST_RECORDS ((EEPROM_PERSIST_END - EEPROM_PERSIST_START) / PERSIST_RECORD_SIZE)
+#define PERSIST_COALESCE_TIME 5000 // how long a non-urgent change waits before it is written, in ms.
+
+// bits in the persisted value
+#define PERSIST_ALARM_TRIGGERED _BV(0)
+#define PERSIST_ALARM_ARMED _BV(1) // only looked at after a brown-out or watchdog reset, see boot_resumed()
+
+/**
+ * scans the ring for the newest valid record. call once at boot, before persist_value().
+ */
+void persist_init();
+
+/**
+ * the current value: the last one stored, whether it has been written out yet or not. 0 on a blank EEPROM.
+ */
+uint8_t persist_value();
+
+/**
+ * sets the value. urgent changes are written immediately, the rest after PERSIST_COALESCE_TIME (TIMER_PERSIST_FLUSH
+ * posts the event; pass it to persist_flush()). storing the value that's already on EEPROM cancels a pending write.
+ */
+void persist_store(uint8_t value, bool urgent);
+
+/**
+ * writes a pending value out now, if there is one.
+ */
+void persist_flush();
+
+/**
+ * number of records written since boot.
+ */
+uint16_t persist_write_count();
+
+#endif //PERSIST_H
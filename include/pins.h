@@ -0,0 +1,28 @@
+#ifndef PINS_H
+#define PINS_H
+
+#define BUTTON_PIN 2
+#define KICKSTAND_PIN 3
+#define ALARM_PIN 4
+#define RED_PIN 5
+#define GREEN_PIN 6
+#define BLUE_PIN 7
+
+// optional sensors (see debounce.h), on port B for its pin change interrupts: the pins marked MISO, SCK and MOSI.
+#define SEAT_PIN 14 // PB3, PCINT3
+#define SIDE_PANEL_PIN 15 // PB1, PCINT1
+#define STEERING_LOCK_PIN 16 // PB2, PCINT2
+
+// optional IMU (see imu.h). the 32U4's hardware i2c pins are 2 and 3, which the switches use, so the bus is bit-banged.
+#define IMU_INT_PIN 8 // INT1 of the sensor, PCINT4
+#define IMU_SDA_PIN 9
+#define IMU_SCL_PIN 10
+
+// optional radio (see radio.h) on Serial1, pins 0 (RX) and 1 (TX).
+#define RADIO_ENABLE_PIN 12
+
+// bike battery through a divider (see battery.h). A0 is ADC7 on the 32U4.
+#define BATTERY_PIN A0
+#define BATTERY_ADC_CHANNEL 7
+
+#endif //PINS_H
@@ -0,0 +1,64 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/**
+ * what the portable parts of the firmware get from the toolchain. on the board that's the arduino core and avr-libc;
+ * on the native (host) build it's a small shim with the same names, so PROGMEM tables, PSTR() format strings and
+ * ATOMIC_BLOCK sections compile unchanged. hardware access goes through hal.h either way.
+ */
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+#else
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define _BV(bit) (1u << (bit))
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#define pgm_read_dword(address) (*(const uint32_t *) (address))
+#define pgm_read_ptr(address) (*(void *const *) (address))
+#define memcpy_P memcpy
+#define strcmp_P strcmp
+#define strcpy_P strcpy
+#define vsnprintf_P vsnprintf
+
+// the simulated interrupts only run between main loop steps, so every block is already atomic.
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (uint8_t atomic_once__ = 1; atomic_once__; atomic_once__ = 0)
+
+// same results as avr-libc's util/crc16.h versions.
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+    data ^= crc;
+    for (uint8_t i = 0; i < 8; ++i) {
+        data = data & 0x80 ? (data << 1) ^ 0x07 : data << 1;
+    }
+    return data;
+}
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+    data ^= crc & 0xFF;
+    data ^= data << 4;
+    return ((((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t) (data >> 4) ^ ((uint16_t) data << 3));
+}
+
+#endif
+
+#endif //PLATFORM_H
@@ -0,0 +1,42 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "platform.h"
+
+/**
+ * time to stay awake after a wake-up edge before the cpu is allowed to sleep again, in ms.
+ * switches bounce when they open or close, so we give the transition checks time to see the settled value.
+ */
+#define POWER_SETTLE_TIME 50
+
+/**
+ * hooks BUTTON_PIN and KICKSTAND_PIN (INT1 / INT0 on the 32U4) up as wake sources, and powers usb down if nothing is
+ * plugged in. call once from setup(), after the pins are configured.
+ */
+void power_init();
+
+/**
+ * puts the cpu to sleep until the next interrupt. returns straight away if there are events waiting.
+ * uses power-down, so only an input edge wakes us, when nothing needs the clock: clock_needed is false, there's no
+ * usb host, and the inputs have been settled for POWER_SETTLE_TIME ms. idle sleep otherwise.
+ * pass clock_needed = true while anything runs off a timer (software timers, the siren) or is waiting on the main
+ * loop to make progress.
+ */
+void power_sleep(bool clock_needed);
+
+/**
+ * runs the cpu at 1 / HAL_CLOCK_THROTTLE_DIV of its clock (hal_clock_throttle()) while idle is true, full speed
+ * otherwise. the clock always stays up while usb is attached (the host keeps the loop busy), and never comes down in a
+ * bench build, whose cycle counts assume 16 MHz. idle is the caller's: nothing that needs the full clock is running.
+ * starting the led timer or the radio brings it back up by itself, see hal.h.
+ */
+void power_throttle(bool idle);
+
+/**
+ * usb follows vbus, checked on every power_sleep() call: unplugged, the usb controller, its pll and the pad regulator
+ * are powered down (hal_usb_detach()); plugged in, they come back up and the board enumerates. the core's usb
+ * interrupt doesn't know about vbus changes, so there's no wake-up on plug-in: it is noticed on the next wake, at most
+ * a watchdog tick (TIMER_SLOW_TICK_MS) later. while detached, log output stays in the log buffer (see log.h).
+ */
+
+#endif //POWER_H
@@ -0,0 +1,101 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "platform.h"
+
+/**
+ * binary protocol for host tools (tools/protocol.py), on the same usb serial port as the text console and the log.
+ * every message is a frame:
+ *   0x00 cobs(type seq data... crc8) 0x00
+ * cobs (consistent overhead byte stuffing) takes the zeros out of the message, so 0x00 only ever marks the start and
+ * end of a frame. text never contains one, so frames and text lines can share the port both ways: a 0x00 switches the
+ * console's reader over to a frame until the next 0x00. the crc8 (ccitt, zero seed) covers type through the last
+ * data byte; a frame that fails it, or doesn't decode, is counted and dropped without a reply.
+ *
+ * seq is the host's, echoed in the reply so it can match them up. replies have the request's type with
+ * PROTOCOL_REPLY set, or are a PROTOCOL_ERROR. multi byte fields are little endian.
+ *
+ *   request            data                        reply data
+ *   GET_STATE          -                           state inputs persist battery_level uptime(ms, u32)
+ *                                                  persist_writes (records since boot, u16)
+ *   ARM                -                           state (after), or ERROR REFUSED
+ *   DISARM             -                           state (after), or ERROR REFUSED
+ *   DUMP_TRACE         -                           one TRACE frame per record, see below
+ *   READ_CONFIG        index                       index value(u16) name
+ *   WRITE_CONFIG       index value(u16) save(0/1)  same as READ_CONFIG, after the write
+ *   READ_STATS         -                           reset_cause log_dropped frames_ok frames_bad replies_dropped (u16s)
+ *                                                  armed_time(s, u32) counters[STAT_COUNT] (u16s, see stats.h)
+ *
+ * DUMP_TRACE replies with TRACE frames, source count index record (see trace.h), oldest first: the RAM ring, then the
+ * EEPROM copy. a source with no records (or no intact copy) sends a single frame with just source and count 0, so the
+ * dump is over with the last EEPROM record.
+ *
+ * replies go out through the log buffer (log_write()), so nothing ever waits on the port. a reply that doesn't fit
+ * is dropped and counted, except the trace dump, which goes out a frame at a time as the buffer empties and gives up
+ * if the host goes away.
+ */
+
+#define PROTOCOL_DATA_MAX 32 // longest data part of a message
+#define PROTOCOL_MESSAGE_MAX (2 + PROTOCOL_DATA_MAX + 1) // type, seq, data, crc
+#define PROTOCOL_FRAME_MAX (1 + PROTOCOL_MESSAGE_MAX + 1 + 1) // both delimiters and the cobs overhead byte
+
+// request types. replies have PROTOCOL_REPLY set.
+#define PROTOCOL_GET_STATE 0x01
+#define PROTOCOL_ARM 0x02
+#define PROTOCOL_DISARM 0x03
+#define PROTOCOL_DUMP_TRACE 0x04
+#define PROTOCOL_READ_CONFIG 0x05
+#define PROTOCOL_WRITE_CONFIG 0x06
+#define PROTOCOL_READ_STATS 0x07
+
+#define PROTOCOL_REPLY 0x80
+#define PROTOCOL_TRACE (PROTOCOL_DUMP_TRACE | PROTOCOL_REPLY)
+
+// error reply: request_type code.
+#define PROTOCOL_ERROR 0xFF
+#define PROTOCOL_ERROR_UNKNOWN 1 // no such request type
+#define PROTOCOL_ERROR_LENGTH 2 // wrong amount of data for the request
+#define PROTOCOL_ERROR_INDEX 3 // no such setting
+#define PROTOCOL_ERROR_VALUE 4 // value out of the setting's range
+#define PROTOCOL_ERROR_REFUSED 5 // arm / disarm isn't possible in the current state
+#define PROTOCOL_ERROR_BUSY 6 // a trace dump is still going out
+
+// the alarm's input snapshot, for GET_STATE.
+typedef uint8_t (*protocol_inputs_t)();
+
+// remote arm (arm true) or disarm. returns false if the current state doesn't allow it.
+typedef bool (*protocol_remote_t)(bool arm);
+
+/**
+ * resets the parser and the counters. inputs and remote must not be nullptr. call once from setup().
+ */
+void protocol_init(protocol_inputs_t inputs, protocol_remote_t remote);
+
+/**
+ * feeds one received byte to the frame reader. returns false if it isn't part of a frame (it's text, for the console).
+ * sets *complete when the byte ended a frame, which has then been handled.
+ */
+bool protocol_receive(uint8_t c, bool *complete);
+
+/**
+ * starts a trace dump, as if DUMP_TRACE had come in with seq. does nothing if one is already going out.
+ */
+void protocol_dump_trace(uint8_t seq);
+
+/**
+ * sends the next frame of a trace dump if there's room for it. call from loop().
+ */
+void protocol_poll();
+
+/**
+ * true while a trace dump is still going out.
+ */
+bool protocol_busy();
+
+/**
+ * frames a message: cobs encodes message[0..length) into frame, with both delimiters. the crc has to be in message
+ * already. frame needs length + 3 bytes. returns the frame's length.
+ */
+uint8_t protocol_frame(const uint8_t *message, uint8_t length, uint8_t *frame);
+
+#endif //PROTOCOL_H
@@ -0,0 +1,84 @@
+#ifndef RADIO_H
+#define RADIO_H
+
+#include "platform.h"
+
+/**
+ * optional radio (a LoRa or BLE module in transparent uart mode on Serial1, powered through RADIO_ENABLE_PIN), so a
+ * trigger gets to someone who isn't in earshot of the siren. off unless built with -DRADIO=1.
+ *
+ * the module is off unless a packet is going out: power on, give it RADIO_WAKE_TIME to boot, write the packet, give
+ * it RADIO_AIR_TIME to get it on air, power off. all of it runs on timers, nothing waits.
+ *
+ *  - alert: sent on every trigger, then repeated RADIO_ALERT_REPEATS times, RADIO_ALERT_INTERVAL apart, until the
+ *    owner clears the alarm or it re-arms. the module powers up before the siren starts, so its boot time overlaps
+ *    with the siren instead of adding to the alert's latency.
+ *  - heartbeats: while armed, a status record every RADIO_HEARTBEAT_INTERVAL, collected into batches of
+ *    RADIO_HEARTBEAT_BATCH so the module wakes once per batch rather than once per record. they run off a slow
+ *    timer (the watchdog, see timers.h), so the chip stays in power-down between them.
+ *  - clear: sent once when the owner clears the alarm. the radio stays quiet after that until the next arming.
+ *
+ * packet: 0xA5, type, RADIO_DEVICE_ID, sequence number, payload length, payload, crc8 (ccitt, over everything after
+ * the sync byte). multi-byte fields are little endian.
+ *   RADIO_PACKET_ALERT      state, inputs, repeat (0 = first)
+ *   RADIO_PACKET_HEARTBEATS number of the first record since power on (2), count, then count x {state, inputs}
+ *   RADIO_PACKET_CLEAR      nothing
+ * there are no timestamps: millis() stops in power-down, and the receiver knows when a packet arrived anyway.
+ */
+
+#ifndef RADIO
+#define RADIO 0
+#endif
+
+#define RADIO_BAUD 9600
+#define RADIO_DEVICE_ID 1
+#define RADIO_WAKE_TIME 60 // ms from power on until the module takes data
+#define RADIO_AIR_TIME 400 // ms from the last byte written until the module is done sending
+#define RADIO_ALERT_REPEATS 5
+#define RADIO_ALERT_INTERVAL 20000UL
+#define RADIO_HEARTBEAT_INTERVAL 600000UL // 10 min
+#define RADIO_HEARTBEAT_BATCH 6 // one transmission an hour
+
+#define RADIO_SYNC 0xA5
+#define RADIO_PACKET_ALERT 1
+#define RADIO_PACKET_HEARTBEATS 2
+#define RADIO_PACKET_CLEAR 3
+#define RADIO_PACKET_MAX (6 + 3 + RADIO_HEARTBEAT_BATCH * 2) // framing plus the biggest payload
+
+/**
+ * powers the module down. call once from setup().
+ */
+void radio_init();
+
+/**
+ * the alarm went off. call first thing on entering the triggered state, so the module boots while the siren starts.
+ */
+void radio_alert(uint8_t state, uint8_t inputs);
+
+/**
+ * the owner cleared the alarm: sends the clear packet and stops everything else.
+ */
+void radio_clear();
+
+/**
+ * starts (true) or stops (false) heartbeats, arming also ends alert repeats. call on entering / leaving the armed
+ * state.
+ */
+void radio_armed(bool armed);
+
+/**
+ * changes the time between heartbeats, in ms. 0 stops them. takes effect straight away if armed.
+ */
+void radio_set_heartbeat_interval(unsigned long interval);
+
+/**
+ * handles the radio's timer events. other events are ignored.
+ */
+void radio_handle(uint8_t event, uint8_t state, uint8_t inputs);
+
+/**
+ * true while the module is powered.
+ */
+bool radio_busy();
+
+#endif //RADIO_H
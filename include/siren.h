@@ -0,0 +1,85 @@
+#ifndef SIREN_H
+#define SIREN_H
+
+#include "platform.h"
+
+/**
+ * siren / relay driver on ALARM_PIN, run entirely from timer1's compare A interrupt. a pattern is a list of steps in
+ * PROGMEM; the interrupt walks through them on its own, so the cpu can sleep (idle) while the alarm sounds.
+ *
+ * timer1 runs in CTC mode with a /64 prescaler, i.e. 4 us per tick. a step is count periods of period ticks each:
+ * SIREN_LOW / SIREN_HIGH hold the pin for the whole step, SIREN_TONE toggles it every period (for a piezo wired
+ * straight to the pin; a relay can't follow that).
+ */
+
+#define SIREN_TICKS_PER_MS 250UL
+
+#define SIREN_LOW 0
+#define SIREN_HIGH 1
+#define SIREN_TONE 2
+
+struct siren_step_t {
+    uint8_t mode;
+    uint16_t period; // timer ticks, at least 1
+    uint16_t count; // periods in this step, at least 1
+};
+
+struct siren_pattern_t {
+    const siren_step_t *steps; // PROGMEM
+    uint8_t step_count;
+    uint8_t repeat_from; // after the last step, play continues from this step
+};
+
+// long holds are split into periods of at most 250 ms, so the 16 bit compare register never overflows.
+constexpr uint16_t siren_hold_count(uint32_t ms) {
+    return (ms + 249) / 250;
+}
+
+/**
+ * step that holds the pin at level (SIREN_LOW / SIREN_HIGH) for ms milliseconds.
+ */
+#define SIREN_HOLD(level, ms) \
+    {level, (uint16_t) ((ms) * SIREN_TICKS_PER_MS / siren_hold_count(ms)), siren_hold_count(ms)}
+
+/**
+ * step that plays a square wave of hz for ms milliseconds.
+ */
+#define SIREN_TONE_HZ(hz, ms) \
+    {SIREN_TONE, (uint16_t) (SIREN_TICKS_PER_MS * 1000 / 2 / (hz)), (uint16_t) ((uint32_t) (ms) * 2 * (hz) / 1000)}
+
+extern const siren_pattern_t SIREN_PATTERN_BEEP; // 1 s on, 1 s off
+extern const siren_pattern_t SIREN_PATTERN_ESCALATING; // short chirps, then longer beeps, then on continuously
+extern const siren_pattern_t SIREN_PATTERN_WARBLE; // two alternating tones, piezo only
+
+/**
+ * sets up timer1 (stopped) and ALARM_PIN. call once from setup().
+ */
+void siren_init();
+
+/**
+ * starts pattern (a PROGMEM siren_pattern_t) from its first step, replacing whatever was playing.
+ */
+void siren_play(const siren_pattern_t *pattern);
+
+/**
+ * plays sounding steps (SIREN_HIGH, SIREN_TONE) for 1 / 2^shift of their length, at least one period, to save the
+ * battery. pauses keep their length. 0 plays patterns as written. takes effect from the next step on.
+ */
+void siren_set_limit(uint8_t shift);
+
+/**
+ * stops the timer and drives ALARM_PIN low.
+ */
+void siren_stop();
+
+/**
+ * advances the pattern by one timer period. runs from the siren timer interrupt.
+ */
+void siren_tick();
+
+/**
+ * true while a pattern is playing. timer1 needs the cpu clock, so power-down sleep is off while this is set.
+ */
+bool siren_active();
+
+#endif //SIREN_H
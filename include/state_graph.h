@@ -0,0 +1,35 @@
+// generated by tools/state_graph.py from src/states.graph, edit that instead.
+#ifndef STATE_GRAPH_H
+#define STATE_GRAPH_H
+
+#include "state_machine.h"
+
+/**
+ * the alarm's states, in the order of src/states.graph. STATE_GRAPH_STATES(X) is X(name) for each of
+ * them, for tables that need an entry per state.
+ */
+#define STATE_GRAPH_STATES(X) \
+    X(START_STATE) \
+    X(WAIT_FOR_BUTTON_PRESS_STATE) \
+    X(WAIT_FOR_KICKSTAND_DOWN_STATE) \
+    X(WAIT_FOR_BUTTON_RELEASE_STATE) \
+    X(ALARM_ARMED_STATE) \
+    X(ALARM_TRIGGERED_STATE) \
+    X(WAIT_FOR_KICKSTAND_UP_STATE) \
+    X(EXIT_DELAY_STATE) \
+    X(ENTRY_DELAY_STATE)
+
+enum : state_t {
+    START_STATE,
+    WAIT_FOR_BUTTON_PRESS_STATE,
+    WAIT_FOR_KICKSTAND_DOWN_STATE,
+    WAIT_FOR_BUTTON_RELEASE_STATE,
+    ALARM_ARMED_STATE,
+    ALARM_TRIGGERED_STATE,
+    WAIT_FOR_KICKSTAND_UP_STATE,
+    EXIT_DELAY_STATE,
+    ENTRY_DELAY_STATE,
+    STATE_COUNT
+};
+
+#endif //STATE_GRAPH_H
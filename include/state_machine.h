@@ -0,0 +1,119 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include "platform.h"
+
+/**
+ * table driven state machine. the whole graph is declared at compile time: every state is a state_def_t and every
+ * transition a transition_def_t, both kept in PROGMEM, so the only thing in SRAM is the current state.
+ *
+ * guards are input masks instead of functions. a transition is taken when (inputs & mask) == value, where inputs is
+ * the bit snapshot passed to sm_dispatch(). transitions are checked in table order and the first match wins, so the
+ * table has to be sorted by from-state (checked by a static_assert with sm_sorted()).
+ *
+ * the machine is event driven: it only does anything when sm_dispatch() is called with an event (see events.h).
+ */
+
+typedef uint8_t state_t;
+
+typedef void (*state_action_t)();
+
+typedef void (*state_event_action_t)(uint8_t event);
+
+typedef void (*transition_hook_t)(state_t from, state_t to, uint8_t inputs);
+
+#define SM_NO_STATE 0xFF // from-state passed to the transition hook when entering the initial state
+
+struct transition_def_t {
+    state_t from;
+    state_t to;
+    uint8_t mask;
+    uint8_t value;
+};
+
+struct state_def_t {
+    state_action_t enter;
+    state_event_action_t event;
+    state_action_t exit;
+    uint8_t first_transition;
+    uint8_t transition_count;
+};
+
+// guard helpers for transition_def_t, expand to {mask, value}.
+#define WHEN_SET(bits) (bits), (bits)
+#define WHEN_CLEAR(bits) (bits), 0
+#define WHEN(set_bits, clear_bits) ((set_bits) | (clear_bits)), (set_bits)
+
+/**
+ * true if transitions[0..count) are grouped by ascending from-state.
+ */
+constexpr bool sm_sorted(const transition_def_t *transitions, uint8_t count) {
+    return count < 2 || (transitions[0].from <= transitions[1].from && sm_sorted(transitions + 1, count - 1));
+}
+
+/**
+ * index of the first transition out of state (or out of any later state, if it has none).
+ */
+constexpr uint8_t sm_first_transition(const transition_def_t *transitions, uint8_t count, state_t state,
+                                      uint8_t i = 0) {
+    return i >= count || transitions[i].from >= state ? i
+                                                      : sm_first_transition(transitions, count, state, i + 1);
+}
+
+/**
+ * number of transitions out of state.
+ */
+constexpr uint8_t sm_transition_count(const transition_def_t *transitions, uint8_t count, state_t state) {
+    return sm_first_transition(transitions, count, state + 1) - sm_first_transition(transitions, count, state);
+}
+
+/**
+ * builds a state_def_t with its transition range filled in from the table. enter, event and exit may be nullptr.
+ */
+#define STATE_DEF(transitions, state, enter, event, exit) \
+    {enter, event, exit, \
+     sm_first_transition(transitions, sizeof(transitions) / sizeof(transition_def_t), state), \
+     sm_transition_count(transitions, sizeof(transitions) / sizeof(transition_def_t), state)}
+
+/**
+ * sets up the machine. states and transitions must point at PROGMEM tables. on_transition (may be nullptr) gets every
+ * transition, with the inputs that matched, right after the old state's exit. every_state_enter (may be nullptr) runs
+ * next, before the new state's enter.
+ */
+void sm_init(const state_def_t *states, const transition_def_t *transitions, transition_hook_t on_transition,
+             state_action_t every_state_enter);
+
+/**
+ * enters the initial state.
+ */
+void sm_startup(state_t initial);
+
+/**
+ * passes event to the current state's event action, then takes the first matching transition out of it, if any.
+ * entering a state posts EVENT_STATE_ENTERED, so the new state's guards get checked on the next dispatch.
+ */
+void sm_dispatch(uint8_t event, uint8_t inputs);
+
+/**
+ * takes the first transition out of the current state in another table than the one given to sm_init(), for instance
+ * one for commands that come from outside the inputs (see protocol.h). transitions has count rows in PROGMEM, in any
+ * order; it runs the same actions and hook as sm_dispatch(). returns false if no row matched.
+ */
+bool sm_take(const transition_def_t *transitions, uint8_t count, uint8_t inputs);
+
+/**
+ * current state.
+ */
+state_t sm_state();
+
+/**
+ * index of state's first transition in the table, and in count how many it has.
+ */
+uint8_t sm_transitions_of(state_t state, uint8_t *count);
+
+/**
+ * true if the guard of the transition at index would let it through with these inputs. doesn't change state.
+ */
+bool sm_guard(uint8_t transition, uint8_t inputs);
+
+#endif //STATE_MACHINE_H
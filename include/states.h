@@ -0,0 +1,35 @@
+#ifndef STATES_H
+#define STATES_H
+
+#include "debounce.h"
+#include "state_graph.h"
+#include "state_machine.h"
+
+/**
+ * the alarm's states and the input bits its transition guards look at. the graph itself is src/states.graph, which
+ * tools/state_graph.py turns into the state enum (state_graph.h) and main.cpp's tables; it also checks that
+ * tools/protocol.py's list of states is in sync. the input bits here are the ones the graph can use, by name without
+ * INPUT_. this is shared with the native simulator (src/native), which checks states by name.
+ */
+
+/**
+ * input bits seen by the transition guards. the switch bits come straight from the debouncer, the rest are derived
+ * from state_data when the snapshot is taken.
+ */
+#define INPUT_BUTTON DEBOUNCE_BUTTON // button pressed
+#define INPUT_KICKSTAND DEBOUNCE_KICKSTAND // kickstand down
+#define INPUT_SEAT DEBOUNCE_SEAT // someone on the seat
+#define INPUT_SIDE_PANEL DEBOUNCE_SIDE_PANEL // side panel in place
+#define INPUT_STEERING_LOCK DEBOUNCE_STEERING_LOCK // steering lock engaged
+#define INPUT_TAMPER _BV(2) // the IMU saw the bike move while armed, see imu.h
+#define INPUT_ALARM_LATCHED _BV(6) // alarm was triggered before the last power off
+#define INPUT_STATE_TIMEOUT _BV(7) // the current state's TIMER_STATE_TIMEOUT has expired
+
+// optional sensors (config.sensors) that aren't fitted read as this, where they can't trigger anything: nobody on the
+// seat, panel on, lock engaged.
+#define INPUT_SENSORS_AT_REST (INPUT_SIDE_PANEL | INPUT_STEERING_LOCK)
+
+static_assert((DEBOUNCE_ALL & (INPUT_TAMPER | INPUT_ALARM_LATCHED | INPUT_STATE_TIMEOUT)) == 0,
+              "derived input bits overlap the debouncer's bits");
+
+#endif //STATES_H
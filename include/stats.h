@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "platform.h"
+
+/**
+ * usage counters for fleet data: how often the alarm arms, goes into the entry delay, actually fires, re-arms on its
+ * own or is silenced by the owner, and how long it spends armed. main.cpp counts them from its transition hook;
+ * they're read out with the protocol's READ_STATS (see protocol.h).
+ *
+ * counting is a RAM increment. the EEPROM copy is only brought up to date every STATS_FLUSH_INTERVAL, and only if
+ * something changed, so a busy day costs a handful of writes instead of one per event. a flush goes out a byte per
+ * stats_poll() call, never waiting on the EEPROM, alternating between two copies in the EEPROM_STATS area:
+ *   [seq][payload length][payload: the counters][crc8 over everything before it]
+ * a copy torn by a power cut fails its crc and the other one, one flush older, is used. what was counted since the
+ * last flush is lost with the power; that's the price of not wearing the EEPROM out.
+ *
+ * time armed counts watchdog ticks (TIMER_SLOW_TICK_MS), which keep going in power-down where millis() doesn't, so
+ * it's only as good as the watchdog oscillator, about 10%.
+ */
+
+#define STATS_FLUSH_INTERVAL 3600000UL // ms between EEPROM updates, at most. 1 h: ~4400 writes a year per copy
+
+// counters. new ones go on the end, the EEPROM copy's length tells old firmware's copies apart.
+enum stat_id_t : uint8_t {
+    STAT_BOOTS, // power-ons and resets
+    STAT_ARMS, // times the alarm armed after the exit delay
+    STAT_ENTRY_DELAYS, // times something set it off while armed
+    STAT_OWNER_RETURNS, // entry delays cut short by the owner (button, or disarm): a false alarm
+    STAT_TRIGGERS, // entry delays that ran out, sounding the siren
+    STAT_REARMS, // triggers that re-armed by themselves after config.rearm_time
+    STAT_SILENCED, // triggers the owner switched off
+    STAT_COUNT
+};
+
+/**
+ * loads the counters from EEPROM and counts a boot. call once from setup(), after timers_init().
+ */
+void stats_init();
+
+/**
+ * adds one to a counter. they stop at 65535.
+ */
+void stats_count(uint8_t id);
+
+/**
+ * starts or stops the clock for the time armed.
+ */
+void stats_armed(bool armed);
+
+/**
+ * handles the stats' slow timer events. call for every event.
+ */
+void stats_handle(uint8_t event);
+
+/**
+ * writes the next byte of a running flush, if the EEPROM is ready for it. call from loop().
+ */
+void stats_poll();
+
+/**
+ * true while a flush is still being written.
+ */
+bool stats_pending();
+
+uint16_t stats_get(uint8_t id);
+
+/**
+ * time spent armed, in seconds.
+ */
+uint32_t stats_armed_time();
+
+#endif //STATS_H
@@ -0,0 +1,91 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "platform.h"
+
+/**
+ * software timers on a timer wheel driven by the system tick (timer0, one tick every TIMER_TICK_US). an expired timer
+ * posts EVENT_TIMER(id) straight from the tick interrupt, so nothing compares timestamps in loop(), and starting or
+ * stopping a timer is O(1) whatever else is running.
+ *
+ * the wheel only counts ticks relative to now, it never stores an absolute time, so there is nothing to go wrong when
+ * millis() wraps after 49 days. durations are converted to ticks in fixed point (1 ms = 250/256 ticks): one-shot
+ * timers round up, so they never fire early, and periodic timers carry the fraction over from period to period, so
+ * they don't drift against millis().
+ *
+ * the system tick also samples the switches (debounce_tick()). it stops in power-down sleep, like millis() does.
+ *
+ * slow timers are for long periods (heartbeats) that mustn't keep the chip out of power-down. they count watchdog
+ * interrupts, one every TIMER_SLOW_TICK_MS, which also wake the chip from power-down, and post EVENT_SLOW_TIMER(id).
+ * the watchdog oscillator is only good to about 10%. it runs all the time, since it also supervises the main loop
+ * (see watchdog.h).
+ */
+
+#define TIMER_TICK_US 1024 // timer0 overflow period: 256 ticks at /64 and 16 MHz
+#define TIMER_WHEEL_BITS 5 // 32 slots. a timer expiring further out takes extra turns of the wheel
+#define TIMER_PERIOD_MAX 17179868UL // longest periodic timer, in ms (~4.7 h). one-shot timers take any duration
+#define TIMER_SLOW_TICK_MS 8000 // watchdog interrupt period
+
+enum timer_id_t : uint8_t {
+    TIMER_STATE_TIMEOUT, // per-state timeout, stopped on every state change
+    TIMER_PERSIST_FLUSH, // deferred EEPROM write, see persist.h
+    TIMER_IMU_SETTLE, // grace period after arming, see imu.h
+    TIMER_RADIO, // radio power sequencing, see radio.h
+    TIMER_RADIO_REPEAT, // alert repeats
+    TIMER_COUNT
+};
+
+enum slow_timer_id_t : uint8_t {
+    SLOW_TIMER_HEARTBEAT, // radio heartbeats while armed
+    SLOW_TIMER_BATTERY, // battery samples, see battery.h
+    SLOW_TIMER_LED, // led beacon, see leds.h
+    SLOW_TIMER_ARMED_TIME, // counts time armed, see stats.h
+    SLOW_TIMER_STATS_FLUSH, // writes the counters out
+    SLOW_TIMER_COUNT
+};
+
+/**
+ * clears every timer and starts the system tick. call once from setup(), after debounce_init().
+ */
+void timers_init();
+
+/**
+ * (re)starts a timer to expire duration ms from now. periodic timers restart themselves on expiry, one-shot timers
+ * stay expired until they are stopped or started again.
+ */
+void timer_start(uint8_t id, unsigned long duration, bool periodic = false);
+
+/**
+ * stops a timer and clears its expired flag.
+ */
+void timer_stop(uint8_t id);
+
+/**
+ * true if a one-shot timer has expired and has not been stopped or restarted since.
+ */
+bool timer_expired(uint8_t id);
+
+/**
+ * true if any timer is counting down. the system tick has to keep running (no power-down sleep) while this is the
+ * case.
+ */
+bool timers_active();
+
+/**
+ * starts a periodic slow timer, expiring every period ms rounded up to whole watchdog ticks.
+ */
+void slow_timer_start(uint8_t id, unsigned long period);
+
+void slow_timer_stop(uint8_t id);
+
+/**
+ * one watchdog tick. runs from the watchdog interrupt, via watchdog_tick().
+ */
+void slow_timers_tick();
+
+/**
+ * one system tick: samples the switches and turns the wheel by one slot. runs from the tick interrupt.
+ */
+void timers_tick();
+
+#endif //TIMERS_H
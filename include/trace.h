@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "platform.h"
+#include "state_machine.h"
+
+/**
+ * binary trace of state transitions for field diagnosis. every transition is stored as a 7 byte record (micros()
+ * timestamp, from-state, to-state, input snapshot) in a RAM ring of the last TRACE_RECORDS transitions, which costs a
+ * few dozen cycles instead of the milliseconds a text line takes.
+ *
+ * with TRACE_SPILL on, trace_spill() copies the ring into the EEPROM_TRACE area in the background (one byte per
+ * trace_poll() call, never waiting on the EEPROM), so the lead-up to a trigger survives a power cut.
+ *
+ * the protocol's DUMP_TRACE (see protocol.h) reads both copies back out with trace_read(), for tools/trace_decode.py
+ * to turn into a timeline. records are little endian: uint32 micros, from-state, to-state, inputs.
+ */
+
+#ifndef TRACE_SPILL
+#define TRACE_SPILL 1
+#endif
+
+#define TRACE_RECORDS 32
+#define TRACE_RECORD_SIZE 7
+
+#define TRACE_SOURCE_RAM 0
+#define TRACE_SOURCE_EEPROM 1
+
+/**
+ * adds a transition to the ring. matches the state machine's transition hook, so the initial state is recorded with
+ * SM_NO_STATE as its from-state.
+ */
+void trace_record(state_t from, state_t to, uint8_t inputs);
+
+/**
+ * starts copying the ring to EEPROM. does nothing if TRACE_SPILL is off or a copy is already running.
+ */
+void trace_spill();
+
+/**
+ * true while a spill is still being written.
+ */
+bool trace_spill_pending();
+
+/**
+ * writes the next byte of a running spill, if the EEPROM is ready for it. call from loop().
+ */
+void trace_poll();
+
+/**
+ * number of records in the RAM ring.
+ */
+uint8_t trace_count();
+
+/**
+ * true if the EEPROM holds a complete, intact spill, with its number of records in count.
+ */
+bool trace_spilled(uint8_t *count);
+
+/**
+ * copies record index (0 is the oldest) of source (TRACE_SOURCE_*) into record, TRACE_RECORD_SIZE bytes. index must
+ * be below trace_count(), or the spill's count.
+ */
+void trace_read(uint8_t source, uint8_t index, uint8_t *record);
+
+#endif //TRACE_H
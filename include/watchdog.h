@@ -0,0 +1,38 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "platform.h"
+
+/**
+ * supervision of the main loop. the watchdog runs in interrupt and reset mode with its TIMER_SLOW_TICK_MS period, the
+ * same interrupt that drives the slow timers (timers.h) and wakes the chip from power-down.
+ *
+ * every loop() pass calls watchdog_kick(), which only sets a flag. every watchdog interrupt checks it:
+ *  - kicked since the last interrupt: clear it, re-arm the interrupt and run the slow timers.
+ *  - not kicked: loop() has been stuck for a whole period (a blocking write to a wedged usb link, a hung i2c bus...).
+ *    the hang hook gets to save state, then the chip resets.
+ * a sleeping loop counts as alive: it kicks on its way into sleep, and the interrupt wakes it for another pass.
+ *
+ * a hang with interrupts off isn't caught: the hardware only drops to reset mode once the interrupt has run, and it
+ * never gets to.
+ */
+
+typedef void (*watchdog_hook_t)();
+
+/**
+ * starts the watchdog. on_hang (may be nullptr) runs from the watchdog interrupt right before a reset. it should be
+ * short and mustn't wait on anything the stuck loop may hold.
+ */
+void watchdog_init(watchdog_hook_t on_hang);
+
+/**
+ * loop() is alive. call once per pass.
+ */
+void watchdog_kick();
+
+/**
+ * one watchdog timeout. runs from the watchdog interrupt.
+ */
+void watchdog_tick();
+
+#endif //WATCHDOG_H
@@ -0,0 +1,111 @@
+#include "hal.h"
+
+#include <util/delay.h>
+
+/*
+ * open drain by hand: a line is pulled low by making it an output (its PORT bit stays 0) and released by making it an
+ * input, so the bus pullups take it high. nothing here waits on clock stretching, which the sensor doesn't do.
+ */
+#define I2C_HALF_BIT_US 5
+
+typedef FastPin<IMU_SDA_PIN> sda;
+typedef FastPin<IMU_SCL_PIN> scl;
+
+static inline void release(bool sda_high) {
+    if (sda_high) {
+        sda::input();
+    } else {
+        sda::output();
+    }
+}
+
+static void clock_pulse() {
+    _delay_us(I2C_HALF_BIT_US);
+    scl::input();
+    _delay_us(I2C_HALF_BIT_US);
+    scl::output();
+}
+
+static void start() {
+    sda::input();
+    scl::input();
+    _delay_us(I2C_HALF_BIT_US);
+    sda::output();
+    _delay_us(I2C_HALF_BIT_US);
+    scl::output();
+}
+
+static void stop() {
+    sda::output();
+    _delay_us(I2C_HALF_BIT_US);
+    scl::input();
+    _delay_us(I2C_HALF_BIT_US);
+    sda::input();
+    _delay_us(I2C_HALF_BIT_US);
+}
+
+/**
+ * shifts out one byte, msb first. true if the device acknowledged.
+ */
+static bool write_byte(uint8_t value) {
+    for (uint8_t bit = 0x80; bit; bit >>= 1) {
+        release(value & bit);
+        clock_pulse();
+    }
+
+    sda::input();
+    _delay_us(I2C_HALF_BIT_US);
+    scl::input();
+    _delay_us(I2C_HALF_BIT_US);
+    bool ack = !sda::read();
+    scl::output();
+    return ack;
+}
+
+static uint8_t read_byte(bool ack) {
+    uint8_t value = 0;
+    sda::input();
+    for (uint8_t i = 0; i < 8; ++i) {
+        _delay_us(I2C_HALF_BIT_US);
+        scl::input();
+        _delay_us(I2C_HALF_BIT_US);
+        value = value << 1 | sda::read();
+        scl::output();
+    }
+
+    release(!ack);
+    clock_pulse();
+    sda::input();
+    return value;
+}
+
+void hal_i2c_init() {
+    // PORT bits at 0 for good, only the direction changes from here on.
+    sda::input();
+    scl::input();
+}
+
+bool hal_i2c_write(uint8_t address, uint8_t reg, uint8_t value) {
+    hal_clock_throttle(false); // _delay_us() counts F_CPU cycles
+    start();
+    bool ok = write_byte(address << 1) && write_byte(reg) && write_byte(value);
+    stop();
+    return ok;
+}
+
+bool hal_i2c_read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t length) {
+    hal_clock_throttle(false); // _delay_us() counts F_CPU cycles
+    start();
+    bool ok = write_byte(address << 1) && write_byte(reg);
+    if (ok) {
+        start(); // repeated start
+        ok = write_byte(address << 1 | 1);
+    }
+    if (ok) {
+        for (uint8_t i = 0; i < length; ++i) {
+            data[i] = read_byte(i + 1 < length);
+        }
+    }
+    stop();
+    return ok;
+}
@@ -0,0 +1,79 @@
+#include "battery.h"
+
+#include "events.h"
+#include "hal.h"
+#include "log.h"
+#include "siren.h"
+#include "timers.h"
+
+static_assert((uint32_t) 1023 * BATTERY_REFERENCE_MV * (BATTERY_DIVIDER_TOP + BATTERY_DIVIDER_BOTTOM)
+              / (BATTERY_DIVIDER_BOTTOM * 1024UL) <= UINT16_MAX, "battery full scale doesn't fit in 16 bits");
+
+static uint16_t smoothed_mv = 0;
+static battery_level_t level = BATTERY_OK;
+
+static uint16_t read_mv() {
+    uint32_t raw = hal_battery_read();
+    return raw * BATTERY_REFERENCE_MV * (BATTERY_DIVIDER_TOP + BATTERY_DIVIDER_BOTTOM)
+           / (BATTERY_DIVIDER_BOTTOM * 1024UL);
+}
+
+/**
+ * level for mv, with hysteresis against the current level: going down needs mv under the threshold, coming back up
+ * needs mv a BATTERY_HYSTERESIS_MV over it.
+ */
+static battery_level_t level_for(uint16_t mv) {
+    if (mv < BATTERY_ABSENT_MV) {
+        return BATTERY_OK;
+    }
+    uint16_t low = BATTERY_LOW_MV + (level >= BATTERY_LOW ? BATTERY_HYSTERESIS_MV : 0);
+    uint16_t critical = BATTERY_CRITICAL_MV + (level >= BATTERY_CRITICAL ? BATTERY_HYSTERESIS_MV : 0);
+    return mv < critical ? BATTERY_CRITICAL : mv < low ? BATTERY_LOW : BATTERY_OK;
+}
+
+static void sample() {
+    uint16_t mv = read_mv();
+    if (mv >= smoothed_mv) {
+        smoothed_mv += (mv - smoothed_mv) >> BATTERY_SMOOTHING_SHIFT;
+    } else {
+        smoothed_mv -= (smoothed_mv - mv) >> BATTERY_SMOOTHING_SHIFT;
+    }
+
+    battery_level_t next = level_for(smoothed_mv);
+    if (next != level) {
+        level = next;
+        LOG_INFO("battery: %u mV, level %u", smoothed_mv, level);
+        event_post(EVENT_BATTERY);
+    }
+}
+
+void battery_init() {
+    // no smoothing on the first sample, and no event: main.cpp picks the profile up from battery_level().
+    smoothed_mv = read_mv();
+    level = BATTERY_OK;
+    level = level_for(smoothed_mv);
+    slow_timer_start(SLOW_TIMER_BATTERY, BATTERY_SAMPLE_INTERVAL);
+}
+
+void battery_set_interval(unsigned long interval) {
+    slow_timer_start(SLOW_TIMER_BATTERY, interval);
+}
+
+void battery_handle(uint8_t event) {
+    if (event == EVENT_SLOW_TIMER(SLOW_TIMER_BATTERY) && !siren_active()) {
+        sample();
+    }
+}
+
+uint16_t battery_mv() {
+    return smoothed_mv;
+}
+
+battery_level_t battery_level() {
+    return level;
+}
+
+#ifdef ARDUINO
+// only there to wake the cpu from adc noise reduction sleep, see hal_battery_read().
+EMPTY_INTERRUPT(ADC_vect);
+#endif
@@ -0,0 +1,271 @@
+#include "bench.h"
+
+#ifdef BENCH
+
+#include "boot.h"
+#include "hal.h"
+#include "states.h"
+
+#include <stdarg.h>
+
+#define BENCH_CYCLES_PER_US (F_CPU / 1000000UL)
+#define BENCH_SWITCH_COMBINATIONS 4 // button x kickstand
+
+struct loop_stats_t {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+};
+
+static volatile uint16_t overflows = 0;
+static uint16_t overhead = 0; // cycles one bench_cycles() pair costs by itself
+
+static loop_stats_t loop_stats[STATE_COUNT];
+static state_t loop_state = 0;
+static uint32_t loop_start = 0;
+static bool loop_discard = false;
+
+static volatile bool edge_pending = false;
+static volatile uint32_t first_edge = 0; // first edge of the current burst
+static volatile uint32_t last_edge = 0;
+static uint16_t latency[BENCH_LATENCY_BINS];
+
+static bool entry_delay_pending = false; // in an entry delay, since entry_delay_start
+static uint32_t entry_delay_start = 0; // ms, the delay outlasts what bench_cycles() can count
+static uint16_t entry_delays = 0;
+static uint32_t entry_delay_min = 0;
+static uint32_t entry_delay_max = 0;
+
+static uint16_t boot_cycles = 0; // .init8 until ALARM_PIN was driven
+static bool boot_siren_pending = false; // latched alarm, waiting for its siren pattern
+static uint32_t boot_siren_us = 0; // main() until that pattern started
+
+static void reset() {
+    for (uint8_t i = 0; i < STATE_COUNT; ++i) {
+        loop_stats[i] = {0, UINT32_MAX, 0, 0};
+    }
+    memset(latency, 0, sizeof(latency));
+    entry_delays = 0;
+    entry_delay_min = UINT32_MAX;
+    entry_delay_max = 0;
+}
+
+void bench_init() {
+    // the led timer counts 0 to 0xFFFF at the cpu clock, as normal mode would. leds.cpp leaves it running.
+    hal_led_timer_start();
+
+    overhead = UINT16_MAX;
+    for (uint8_t i = 0; i < 8; ++i) {
+        uint32_t start = bench_cycles();
+        uint16_t cost = bench_cycles() - start;
+        if (cost < overhead) {
+            overhead = cost;
+        }
+    }
+    reset();
+}
+
+uint32_t bench_cycles() {
+    uint16_t high;
+    uint16_t low;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        low = TCNT3;
+        high = overflows;
+        // an overflow since interrupts went off hasn't been counted yet. a low count means it happened before the read.
+        if ((TIFR3 & _BV(TOV3)) && low < 0x8000) {
+            ++high;
+        }
+    }
+    return (uint32_t) high << 16 | low;
+}
+
+void bench_loop_begin() {
+    loop_state = sm_state();
+    loop_start = bench_cycles();
+}
+
+void bench_loop_end() {
+    uint32_t cycles = bench_cycles() - loop_start - overhead;
+    if (loop_discard) {
+        loop_discard = false;
+        return;
+    }
+
+    loop_stats_t &stats = loop_stats[loop_state];
+    ++stats.count;
+    stats.total += cycles;
+    if (cycles < stats.min) {
+        stats.min = cycles;
+    }
+    if (cycles > stats.max) {
+        stats.max = cycles;
+    }
+}
+
+void bench_edge() {
+    // a bouncing switch fires many edges. only the first one of a burst starts the clock.
+    uint32_t now = bench_cycles();
+    if (!edge_pending || now - last_edge > BENCH_EDGE_WINDOW_US * BENCH_CYCLES_PER_US) {
+        first_edge = now;
+        edge_pending = true;
+    }
+    last_edge = now;
+}
+
+void bench_boot_begin() {
+    // timer3 from the top at the cpu clock. init() reconfigures it before anything else uses it.
+    TCCR3A = 0;
+    TCCR3B = _BV(CS30);
+    TCNT3 = 0;
+}
+
+void bench_boot_end() {
+    boot_cycles = TCNT3;
+    TCCR3B = 0;
+    boot_siren_pending = boot_alarm_latched();
+}
+
+/**
+ * the alarm has just reacted to something. files the latency if that was a recent edge burst.
+ */
+static void reaction() {
+    uint32_t now = bench_cycles();
+    uint32_t first;
+    bool counted;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // a reaction to something other than a recent edge (the latched alarm at power on, the IMU, an entry delay
+        // running out) isn't timed.
+        counted = edge_pending && now - last_edge <= BENCH_EDGE_WINDOW_US * BENCH_CYCLES_PER_US;
+        first = first_edge;
+        edge_pending = false;
+    }
+    if (!counted) {
+        return;
+    }
+
+    uint32_t us = (now - first) / BENCH_CYCLES_PER_US;
+    uint32_t bin = us / BENCH_LATENCY_BIN_US;
+    ++latency[bin < BENCH_LATENCY_BINS ? bin : BENCH_LATENCY_BINS - 1];
+}
+
+void bench_siren_on() {
+    if (boot_siren_pending) {
+        boot_siren_pending = false;
+        boot_siren_us = hal_micros();
+    }
+    reaction();
+
+    if (entry_delay_pending) {
+        entry_delay_pending = false;
+        uint32_t ms = hal_millis() - entry_delay_start;
+        ++entry_delays;
+        if (ms < entry_delay_min) {
+            entry_delay_min = ms;
+        }
+        if (ms > entry_delay_max) {
+            entry_delay_max = ms;
+        }
+    }
+}
+
+void bench_entry_delay() {
+    reaction();
+    // an owner who disarms in time leaves this set, the next entry delay starts it over.
+    entry_delay_pending = true;
+    entry_delay_start = hal_millis();
+}
+
+static void report_printf_P(const char *fmt, ...) {
+    char line[80];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf_P(line, sizeof(line), fmt, args);
+    va_end(args);
+    Serial.println(line);
+}
+
+// same signature as sm_guard(), to time the loop and call around it.
+static bool __attribute__((noinline)) empty_guard(uint8_t transition, uint8_t inputs) {
+    asm volatile("");
+    return false;
+}
+
+/**
+ * cycles for BENCH_GUARD_REPS calls of guard. the best of a few runs, so an interrupt landing in one doesn't count.
+ */
+static uint32_t time_guard(bool (*guard)(uint8_t, uint8_t), uint8_t transition, uint8_t inputs) {
+    uint32_t best = UINT32_MAX;
+    for (uint8_t run = 0; run < 3; ++run) {
+        volatile uint8_t sink = 0;
+        uint32_t start = bench_cycles();
+        for (uint8_t i = 0; i < BENCH_GUARD_REPS; ++i) {
+            sink += guard(transition, inputs);
+        }
+        uint32_t cycles = bench_cycles() - start;
+        if (cycles < best) {
+            best = cycles;
+        }
+    }
+    return best;
+}
+
+static void report_guards() {
+    report_printf_P(PSTR("guard cycles, switches none / button / kickstand / both"));
+    for (state_t state = 0; state < STATE_COUNT; ++state) {
+        uint8_t count;
+        uint8_t first = sm_transitions_of(state, &count);
+        for (uint8_t t = first; t < first + count; ++t) {
+            uint16_t cost[BENCH_SWITCH_COMBINATIONS];
+            for (uint8_t inputs = 0; inputs < BENCH_SWITCH_COMBINATIONS; ++inputs) {
+                uint32_t base = time_guard(empty_guard, t, inputs);
+                uint32_t guard = time_guard(sm_guard, t, inputs);
+                cost[inputs] = guard > base ? (guard - base + BENCH_GUARD_REPS / 2) / BENCH_GUARD_REPS : 0;
+            }
+            report_printf_P(PSTR("  %2u state %u: %u %u %u %u"), t, state, cost[0], cost[1], cost[2], cost[3]);
+        }
+    }
+}
+
+void bench_report() {
+    report_printf_P(PSTR("bench, cpu cycles at %lu MHz, timer overhead %u"), F_CPU / 1000000UL, overhead);
+
+    report_printf_P(PSTR("loop cycles per state: passes min mean max"));
+    for (state_t state = 0; state < STATE_COUNT; ++state) {
+        const loop_stats_t &stats = loop_stats[state];
+        if (stats.count == 0) {
+            continue;
+        }
+        report_printf_P(PSTR("  state %u: %lu %lu %lu %lu"), state, stats.count, stats.min,
+                        (uint32_t) (stats.total / stats.count), stats.max);
+    }
+
+    report_guards();
+
+    report_printf_P(PSTR("input to alarm latency, %u us bins"), BENCH_LATENCY_BIN_US);
+    for (uint8_t bin = 0; bin < BENCH_LATENCY_BINS; ++bin) {
+        if (latency[bin]) {
+            report_printf_P(PSTR("  %s%lu us: %u"), bin == BENCH_LATENCY_BINS - 1 ? ">=" : "",
+                            (uint32_t) bin * BENCH_LATENCY_BIN_US, latency[bin]);
+        }
+    }
+
+    if (entry_delays) {
+        report_printf_P(PSTR("entry delay to siren, ms: %u delays min %lu max %lu"), entry_delays, entry_delay_min,
+                        entry_delay_max);
+    }
+
+    report_printf_P(PSTR("boot: alarm flag read and pin driven %u cycles into .init8"), boot_cycles);
+    if (boot_alarm_latched()) {
+        report_printf_P(PSTR("boot: latched alarm, siren pattern %lu us after main()"), boot_siren_us);
+    }
+
+    reset();
+    loop_discard = true;
+}
+
+void bench_timer_overflow() {
+    ++overflows;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "boot.h"
+
+#include "bench.h"
+#include "hal.h"
+#include "persist.h"
+
+static bool alarm_latched = false;
+
+#ifdef ARDUINO
+// taken in .init3, before .bss is cleared, so it can't live there.
+static uint8_t reset_cause __attribute__((section(".noinit")));
+#else
+static uint8_t reset_cause = 0;
+#endif
+
+void boot_early() {
+#ifndef ARDUINO
+    reset_cause = hal_reset_cause();
+#endif
+    BENCH_BOOT_BEGIN();
+    persist_init();
+    alarm_latched = persist_value() & PERSIST_ALARM_TRIGGERED;
+    if (alarm_latched) {
+        hal_alarm_init();
+        hal_alarm_write(true);
+    }
+    BENCH_BOOT_END();
+}
+
+bool boot_alarm_latched() {
+    return alarm_latched;
+}
+
+uint8_t boot_reset_cause() {
+    return reset_cause;
+}
+
+bool boot_resumed() {
+    return reset_cause & (HAL_RESET_BROWN_OUT | HAL_RESET_WATCHDOG);
+}
+
+#ifdef ARDUINO
+
+/**
+ * a watchdog reset leaves the watchdog on with its 16 ms timeout, less than the rest of the startup takes, so it has
+ * to be stopped before anything else. .init3 is the earliest the stack is set up to call out from.
+ */
+static void __attribute__((naked, used, section(".init3"))) boot_init3() {
+    reset_cause = hal_reset_cause();
+}
+
+/**
+ * .init8 runs after .data and .bss are set up and the static constructors have run (.init6), so the modules' statics
+ * are valid, but before main(). code in the init sections falls through from one to the next, so this has to be naked
+ * (no ret) and only call out to normal functions.
+ */
+static void __attribute__((naked, used, section(".init8"))) boot_init8() {
+    boot_early();
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "config.h"
+
+#include "debounce.h"
+#include "eeprom_layout.h"
+#include "hal.h"
+#include "imu.h"
+
+#define CONFIG_CRC_SEED 0xC3 // so that neither an erased nor a zeroed block passes the check
+
+// [version][length] header in front of the payload, crc after it.
+#define CONFIG_HEADER 2
+#define CONFIG_PAYLOAD_MAX (EEPROM_CONFIG_END - EEPROM_CONFIG_START - CONFIG_HEADER - 1)
+
+static_assert(sizeof(config_t) <= CONFIG_PAYLOAD_MAX, "config doesn't fit its EEPROM area");
+
+/**
+ * one row per field of config_t: what the console calls it and which values it takes.
+ */
+struct setting_t {
+    char name[CONFIG_NAME_MAX];
+    uint8_t offset;
+    uint8_t size;
+    uint16_t min;
+    uint16_t max;
+};
+
+#define SETTING(field, min, max) {#field, offsetof(config_t, field), sizeof(config_t::field), min, max}
+
+static const setting_t SETTINGS[] PROGMEM = {
+        SETTING(exit_delay, 0, 3600),
+        SETTING(entry_delay, 0, 3600),
+        SETTING(rearm_time, 10, 3600),
+        SETTING(debounce_samples, 1, DEBOUNCE_SAMPLES),
+        SETTING(siren_pattern, 0, SIREN_CHOICE_COUNT - 1),
+        SETTING(tamper_score, 1, UINT16_MAX),
+        SETTING(sensors, 0, DEBOUNCE_SENSORS >> DEBOUNCE_SENSORS_SHIFT),
+};
+
+#define SETTING_COUNT (sizeof(SETTINGS) / sizeof(setting_t))
+
+static const config_t DEFAULTS PROGMEM = {
+        CONFIG_EXIT_DELAY,
+        CONFIG_ENTRY_DELAY,
+        CONFIG_REARM_TIME,
+        DEBOUNCE_SAMPLES,
+        SIREN_CHOICE_BEEP,
+        IMU_TAMPER_SCORE,
+        0,
+};
+
+config_t config;
+
+static uint16_t read_field(uint8_t offset, uint8_t size) {
+    const uint8_t *bytes = (const uint8_t *) &config + offset;
+    return size == 1 ? bytes[0] : bytes[0] | (uint16_t) bytes[1] << 8;
+}
+
+static void write_field(uint8_t offset, uint8_t size, uint16_t value) {
+    uint8_t *bytes = (uint8_t *) &config + offset;
+    bytes[0] = value & 0xFF;
+    if (size == 2) {
+        bytes[1] = value >> 8;
+    }
+}
+
+static void load_setting(uint8_t index, setting_t *setting) {
+    memcpy_P(setting, &SETTINGS[index], sizeof(*setting));
+}
+
+/**
+ * true if the field described by setting holds a value it's allowed to.
+ */
+static bool in_range(const setting_t *setting, uint16_t value) {
+    return value >= setting->min && value <= setting->max;
+}
+
+void config_defaults() {
+    memcpy_P(&config, &DEFAULTS, sizeof(config));
+}
+
+void config_init() {
+    config_defaults();
+
+    uint8_t version = hal_eeprom_read(EEPROM_CONFIG_START);
+    uint8_t length = hal_eeprom_read(EEPROM_CONFIG_START + 1);
+    if (version != CONFIG_VERSION || length > CONFIG_PAYLOAD_MAX) {
+        return;
+    }
+
+    uint8_t crc = CONFIG_CRC_SEED;
+    for (uint8_t i = 0; i < CONFIG_HEADER + length; ++i) {
+        crc = _crc8_ccitt_update(crc, hal_eeprom_read(EEPROM_CONFIG_START + i));
+    }
+    if (hal_eeprom_read(EEPROM_CONFIG_START + CONFIG_HEADER + length) != crc) {
+        return;
+    }
+
+    // an older, shorter block leaves the fields it doesn't have at their defaults. a longer one (saved by newer
+    // firmware with the same version) only has extra fields on the end, which we don't know about.
+    uint8_t *bytes = (uint8_t *) &config;
+    for (uint8_t i = 0; i < length && i < sizeof(config_t); ++i) {
+        bytes[i] = hal_eeprom_read(EEPROM_CONFIG_START + CONFIG_HEADER + i);
+    }
+
+    // checked once here, so nothing that reads config has to.
+    setting_t setting;
+    for (uint8_t i = 0; i < SETTING_COUNT; ++i) {
+        load_setting(i, &setting);
+        if (!in_range(&setting, read_field(setting.offset, setting.size))) {
+            memcpy_P(bytes + setting.offset, (const uint8_t *) &DEFAULTS + setting.offset, setting.size);
+        }
+    }
+}
+
+void config_save() {
+    const uint8_t header[CONFIG_HEADER] = {CONFIG_VERSION, sizeof(config_t)};
+    uint8_t crc = CONFIG_CRC_SEED;
+    for (uint8_t i = 0; i < CONFIG_HEADER; ++i) {
+        hal_eeprom_update(EEPROM_CONFIG_START + i, header[i]);
+        crc = _crc8_ccitt_update(crc, header[i]);
+    }
+
+    const uint8_t *bytes = (const uint8_t *) &config;
+    for (uint8_t i = 0; i < sizeof(config_t); ++i) {
+        hal_eeprom_update(EEPROM_CONFIG_START + CONFIG_HEADER + i, bytes[i]);
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    hal_eeprom_update(EEPROM_CONFIG_START + CONFIG_HEADER + sizeof(config_t), crc);
+}
+
+uint8_t config_count() {
+    return SETTING_COUNT;
+}
+
+int8_t config_find(const char *name) {
+    for (uint8_t i = 0; i < SETTING_COUNT; ++i) {
+        if (strcmp_P(name, SETTINGS[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void config_name(uint8_t index, char *buffer) {
+    strcpy_P(buffer, SETTINGS[index].name);
+}
+
+uint16_t config_get(uint8_t index) {
+    setting_t setting;
+    load_setting(index, &setting);
+    return read_field(setting.offset, setting.size);
+}
+
+bool config_set(uint8_t index, uint16_t value) {
+    setting_t setting;
+    load_setting(index, &setting);
+    if (!in_range(&setting, value)) {
+        return false;
+    }
+    // the only field read from an isr (debounce_samples, by the system tick) is a single byte, everything else is read
+    // from loop(), so a write can't be seen half done.
+    write_field(setting.offset, setting.size, value);
+    return true;
+}
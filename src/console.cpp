@@ -0,0 +1,157 @@
+#include "console.h"
+
+#include "bench.h"
+#include "config.h"
+#include "hal.h"
+#include "log.h"
+#include "protocol.h"
+
+// replies go out whatever LOG_LEVEL is, they're what was asked for.
+#define REPLY(fmt, ...) log_printf_P(PSTR(fmt), ##__VA_ARGS__)
+
+static char line[CONSOLE_LINE_MAX];
+static uint8_t line_length = 0;
+static bool line_too_long = false;
+
+// next setting for a bare "get" to print, config_count() when not listing.
+static uint8_t listing = 0;
+
+static void reply_setting(uint8_t index) {
+    char name[CONFIG_NAME_MAX];
+    config_name(index, name);
+    REPLY("%s = %u", name, config_get(index));
+}
+
+/**
+ * parses a whole word as a decimal number. false if it isn't one or doesn't fit 16 bits.
+ */
+static bool parse_number(const char *word, uint16_t *value) {
+    if (!*word) {
+        return false;
+    }
+    uint32_t n = 0;
+    for (; *word; ++word) {
+        if (*word < '0' || *word > '9') {
+            return false;
+        }
+        n = n * 10 + (*word - '0');
+        if (n > UINT16_MAX) {
+            return false;
+        }
+    }
+    *value = n;
+    return true;
+}
+
+/**
+ * splits off the first space separated word of text: terminates it and returns what comes after, skipping spaces.
+ */
+static char *next_word(char *text) {
+    while (*text && *text != ' ') {
+        ++text;
+    }
+    while (*text == ' ') {
+        *text++ = 0;
+    }
+    return text;
+}
+
+static void run_line() {
+    char *command = line;
+    while (*command == ' ') {
+        ++command;
+    }
+    char *name = next_word(command);
+    char *value_text = next_word(name);
+    next_word(value_text); // anything after the value is ignored
+
+    if (!*command) {
+        return;
+    }
+    if (strcmp_P(command, PSTR("T")) == 0) {
+        protocol_dump_trace(0);
+        return;
+    }
+#ifdef BENCH
+    if (strcmp_P(command, PSTR("B")) == 0) {
+        bench_report();
+        return;
+    }
+#endif
+    if (strcmp_P(command, PSTR("save")) == 0) {
+        config_save();
+        REPLY("saved");
+        return;
+    }
+    if (strcmp_P(command, PSTR("defaults")) == 0) {
+        config_defaults();
+        REPLY("defaults loaded, save to keep them");
+        return;
+    }
+
+    bool get = strcmp_P(command, PSTR("get")) == 0;
+    if (!get && strcmp_P(command, PSTR("set")) != 0) {
+        REPLY("unknown command %s", command);
+        return;
+    }
+    if (get && !*name) {
+        listing = 0;
+        return;
+    }
+    int8_t index = config_find(name);
+    if (index < 0) {
+        REPLY("unknown setting %s", name);
+        return;
+    }
+    if (!get) {
+        uint16_t value;
+        if (!parse_number(value_text, &value) || !config_set(index, value)) {
+            REPLY("bad value for %s", name);
+            return;
+        }
+    }
+    reply_setting(index);
+}
+
+void console_init() {
+    line_length = 0;
+    line_too_long = false;
+    listing = config_count();
+}
+
+void console_poll() {
+    // a full listing doesn't fit the log buffer, so it goes out a line at a time as the buffer empties.
+    if (listing < config_count() && !log_pending()) {
+        reply_setting(listing++);
+    }
+
+    // one command (or protocol frame) per poll, so a burst of them can't overrun the log buffer with their replies.
+    while (hal_serial_available() > 0) {
+        char c = hal_serial_read();
+        bool frame_done;
+        if (protocol_receive(c, &frame_done)) {
+            if (frame_done) {
+                return;
+            }
+            continue;
+        }
+        if (c != '\n' && c != '\r') {
+            if (line_length < CONSOLE_LINE_MAX - 1) {
+                line[line_length++] = c;
+            } else {
+                line_too_long = true;
+            }
+            continue;
+        }
+
+        line[line_length] = 0;
+        if (line_too_long) {
+            REPLY("line too long");
+        } else {
+            run_line();
+        }
+        line_length = 0;
+        line_too_long = false;
+        return;
+    }
+}
@@ -0,0 +1,50 @@
+#include "debounce.h"
+
+#include "config.h"
+#include "events.h"
+#include "hal.h"
+
+static_assert(DEBOUNCE_SAMPLES >= 1 && DEBOUNCE_SAMPLES <= 8, "the vertical counter has 3 bits");
+
+// the counter: bit i of count[k] is bit k of switch i's count of samples in a row that disagreed with its debounced
+// state.
+static volatile uint8_t count[3];
+
+volatile uint8_t debounced_inputs = 0;
+
+void debounce_init() {
+    count[0] = count[1] = count[2] = 0;
+    debounced_inputs = hal_inputs_read() & DEBOUNCE_ALL;
+}
+
+bool debounce_settled() {
+    return (count[0] | count[1] | count[2]) == 0;
+}
+
+void debounce_tick() {
+    uint8_t state = debounced_inputs;
+    uint8_t c0 = count[0];
+    uint8_t c1 = count[1];
+    uint8_t c2 = count[2];
+
+    // switches that read differently from their debounced state. the rest start counting from 0 again.
+    uint8_t delta = (hal_inputs_read() ^ state) & DEBOUNCE_ALL;
+
+    // the ones whose count has got to config.debounce_samples - 1 flip with this sample: compare all counters with
+    // it at once, bit k of the limit spread over a whole byte.
+    uint8_t limit = config.debounce_samples - 1;
+    uint8_t at_limit = ~((c0 ^ (limit & 1 ? 0xFF : 0)) | (c1 ^ (limit & 2 ? 0xFF : 0)) | (c2 ^ (limit & 4 ? 0xFF : 0)));
+    uint8_t flip = delta & at_limit;
+
+    // everything else that disagrees counts up by one (a ripple carry through the three bits), the rest goes to 0.
+    uint8_t counting = delta & ~flip;
+    uint8_t carry = c0 & counting;
+    count[0] = ~c0 & counting;
+    count[1] = (c1 ^ carry) & counting;
+    count[2] = (c2 ^ (c1 & carry)) & counting;
+
+    if (flip) {
+        debounced_inputs = state ^ flip;
+        event_post(EVENT_INPUT);
+    }
+}
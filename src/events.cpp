@@ -0,0 +1,40 @@
+#include "events.h"
+
+static_assert((EVENT_QUEUE_SIZE & (EVENT_QUEUE_SIZE - 1)) == 0, "EVENT_QUEUE_SIZE must be a power of two");
+
+static volatile uint8_t queue[EVENT_QUEUE_SIZE];
+static volatile uint8_t head = 0; // next slot to write
+static volatile uint8_t tail = 0; // next slot to read
+
+uint8_t event_overflows = 0;
+
+bool event_post(uint8_t event) {
+    bool posted = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint8_t next = (head + 1) & (EVENT_QUEUE_SIZE - 1);
+        if (next != tail) {
+            queue[head] = event;
+            head = next;
+            posted = true;
+        } else if (event_overflows != 0xFF) {
+            ++event_overflows;
+        }
+    }
+    return posted;
+}
+
+bool event_pop(uint8_t *event) {
+    bool popped = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (tail != head) {
+            *event = queue[tail];
+            tail = (tail + 1) & (EVENT_QUEUE_SIZE - 1);
+            popped = true;
+        }
+    }
+    return popped;
+}
+
+bool events_pending() {
+    return head != tail;
+}
@@ -0,0 +1,215 @@
+#include "imu.h"
+
+#include "config.h"
+#include "events.h"
+#include "hal.h"
+#include "log.h"
+#include "motion.h"
+#include "timers.h"
+
+// LIS3DH registers and the bits we use.
+#define REG_WHO_AM_I 0x0F
+#define REG_CTRL1 0x20
+#define REG_CTRL2 0x21
+#define REG_CTRL3 0x22
+#define REG_CTRL4 0x23
+#define REG_CTRL5 0x24
+#define REG_REFERENCE 0x26
+#define REG_OUT_X_L 0x28
+#define REG_FIFO_CTRL 0x2E
+#define REG_FIFO_SRC 0x2F
+#define REG_INT1_CFG 0x30
+#define REG_INT1_SRC 0x31
+#define REG_INT1_THS 0x32
+#define REG_INT1_DURATION 0x33
+
+#define AUTO_INCREMENT 0x80
+#define WHO_AM_I_LIS3DH 0x33
+
+#define CTRL1_POWER_DOWN 0x00
+#define CTRL1_50HZ_LOW_POWER 0x4F // 50 Hz, 8 bit low power mode, x y z on
+#define CTRL2_HIGH_PASS_INT1 0x01 // high-pass filter on the INT1 comparator only, the FIFO gets raw data
+#define CTRL3_I1_IA1 0x40
+#define CTRL3_I1_WTM 0x04
+#define CTRL5_FIFO_EN 0x40
+#define CTRL5_LIR_INT1 0x08
+#define FIFO_CTRL_STREAM 0x80
+#define FIFO_SRC_OVRN 0x40
+#define FIFO_SRC_FSS 0x1F
+#define INT1_CFG_XYZ_HIGH 0x2A // or of x, y and z above the threshold
+#define INT1_SRC_IA 0x40
+
+#define IMU_FIFO_SIZE 32
+
+static_assert(IMU_FIFO_WATERMARK > 0 && IMU_FIFO_WATERMARK < IMU_FIFO_SIZE, "watermark must fit the FIFO");
+
+static bool present = false;
+static bool tampered = false;
+
+#if IMU
+
+static bool armed = false;
+static bool watching = false; // past the settle time
+static bool batching = false; // woken up, reading FIFO batches
+static uint8_t moving_batches = 0;
+
+static bool write(uint8_t reg, uint8_t value) {
+    if (hal_i2c_write(IMU_ADDRESS, reg, value)) {
+        return true;
+    }
+    LOG_WARN("imu: no ack writing %02x", reg);
+    return false;
+}
+
+static uint8_t read(uint8_t reg) {
+    uint8_t value = 0;
+    hal_i2c_read(IMU_ADDRESS, reg, &value, 1);
+    return value;
+}
+
+/**
+ * waits for the first movement: INT1 on the high-passed wake-on-motion comparator, latched until INT1_SRC is read.
+ */
+static void wait_for_wake() {
+    watching = true;
+    batching = false;
+    moving_batches = 0;
+    motion_reset();
+    write(REG_CTRL3, 0);
+    read(REG_REFERENCE); // resets the high-pass filter to the current orientation
+    read(REG_INT1_SRC);
+    write(REG_CTRL3, CTRL3_I1_IA1);
+}
+
+/**
+ * reads everything in the FIFO into the motion score. returns the batch's score.
+ */
+static uint16_t read_batch() {
+    uint8_t src = read(REG_FIFO_SRC);
+    uint8_t count = (src & FIFO_SRC_FSS) + (src & FIFO_SRC_OVRN ? 1 : 0);
+
+    for (uint8_t i = 0; i < count; ++i) {
+        // one sample per read: the FIFO moves on once OUT_Z_H has been read. 8 bit data is in the high bytes.
+        int8_t raw[6];
+        if (!hal_i2c_read(IMU_ADDRESS, REG_OUT_X_L | AUTO_INCREMENT, (uint8_t *) raw, sizeof(raw))) {
+            break;
+        }
+        motion_add({raw[1], raw[3], raw[5]});
+    }
+    return motion_end_batch();
+}
+
+static void on_motion() {
+    if (!watching) {
+        return;
+    }
+
+    if (!batching) {
+        // woken by the comparator: clear it and collect batches from here on.
+        read(REG_INT1_SRC);
+        write(REG_CTRL3, CTRL3_I1_WTM);
+        batching = true;
+        LOG_DEBUG("imu: wake");
+    } else {
+        uint16_t batch = read_batch();
+        if (batch < IMU_STILL_SCORE) {
+            wait_for_wake();
+        } else if (motion_score() < config.tamper_score) {
+            moving_batches = 0;
+        } else if (++moving_batches >= IMU_TAMPER_BATCHES && !tampered) {
+            tampered = true;
+            LOG_INFO("imu: tamper, score %u", motion_score());
+        }
+    }
+
+    // INT1 can be active again already (a full FIFO right after the switch to batches), which is no edge for the pin
+    // change interrupt. treat it like one.
+    if (hal_imu_irq_level()) {
+        event_post(EVENT_MOTION);
+    }
+}
+
+void imu_init() {
+    hal_i2c_init();
+    uint8_t id = 0;
+    present = hal_i2c_read(IMU_ADDRESS, REG_WHO_AM_I, &id, 1) && id == WHO_AM_I_LIS3DH;
+    if (!present) {
+        LOG_WARN("imu: not found");
+        return;
+    }
+    write(REG_CTRL1, CTRL1_POWER_DOWN);
+    hal_imu_irq_init();
+}
+
+void imu_arm() {
+    tampered = false;
+    if (!present) {
+        return;
+    }
+
+    armed = true;
+    moving_batches = 0;
+    write(REG_CTRL3, 0);
+    write(REG_CTRL2, CTRL2_HIGH_PASS_INT1);
+    write(REG_CTRL4, 0);
+    write(REG_CTRL5, CTRL5_FIFO_EN | CTRL5_LIR_INT1);
+    write(REG_FIFO_CTRL, FIFO_CTRL_STREAM | IMU_FIFO_WATERMARK);
+    write(REG_INT1_THS, IMU_WAKE_THRESHOLD);
+    write(REG_INT1_DURATION, IMU_WAKE_DURATION);
+    write(REG_INT1_CFG, INT1_CFG_XYZ_HIGH);
+    write(REG_CTRL1, CTRL1_50HZ_LOW_POWER);
+    timer_start(TIMER_IMU_SETTLE, IMU_SETTLE_TIME);
+}
+
+void imu_disarm() {
+    if (!armed) {
+        return;
+    }
+    armed = false;
+    watching = false;
+    timer_stop(TIMER_IMU_SETTLE);
+    write(REG_CTRL3, 0);
+    write(REG_CTRL1, CTRL1_POWER_DOWN);
+}
+
+void imu_handle(uint8_t event) {
+    if (event == EVENT_TIMER(TIMER_IMU_SETTLE) && armed) {
+        wait_for_wake();
+    } else if (event == EVENT_MOTION) {
+        on_motion();
+    }
+}
+
+void imu_irq() {
+    if (hal_imu_irq_level()) {
+        event_post(EVENT_MOTION);
+    }
+}
+
+#else
+
+void imu_init() {
+}
+
+void imu_arm() {
+    tampered = false;
+}
+
+void imu_disarm() {
+}
+
+void imu_handle(uint8_t event) {
+}
+
+void imu_irq() {
+}
+
+#endif
+
+bool imu_present() {
+    return present;
+}
+
+bool imu_tampered() {
+    return tampered;
+}
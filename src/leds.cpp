@@ -0,0 +1,206 @@
+#include "leds.h"
+
+#include "bench.h"
+#include "events.h"
+#include "hal.h"
+#include "timers.h"
+
+
+static const led_step_t ARMED_STEPS[] PROGMEM = {
+        LED_FADE(20, 160, 0, 0),
+        LED_HOLD(40, 160, 0, 0),
+        LED_FADE(20, 0, 0, 0),
+};
+const led_pattern_t LED_PATTERN_ARMED PROGMEM = {ARMED_STEPS, sizeof(ARMED_STEPS) / sizeof(led_step_t), LED_ONCE};
+
+static const led_step_t BREATHE_STEPS[] PROGMEM = {
+        LED_FADE(1500, 0, 255, 0),
+        LED_FADE(1500, 0, 0, 0),
+        LED_HOLD(500, 0, 0, 0),
+};
+const led_pattern_t LED_PATTERN_BREATHE PROGMEM = {BREATHE_STEPS, sizeof(BREATHE_STEPS) / sizeof(led_step_t), 0};
+
+static const led_step_t COUNTDOWN_STEPS[] PROGMEM = {
+        LED_HOLD(250, 255, 0, 0),
+        LED_HOLD(250, 0, 0, 0),
+};
+const led_pattern_t LED_PATTERN_COUNTDOWN PROGMEM = {COUNTDOWN_STEPS, sizeof(COUNTDOWN_STEPS) / sizeof(led_step_t), 0};
+
+
+// only touched by the interrupt while a pattern plays.
+static const led_step_t *volatile steps = nullptr; // nullptr: solid colour
+static volatile uint8_t step_count = 0;
+static volatile uint8_t repeat_from = 0;
+static volatile uint8_t step = 0;
+static volatile uint8_t mode = LED_STEP_HOLD;
+static volatile uint16_t remaining = 0;
+static uint16_t level[3]; // current colour, 8.8 fixed point
+static int16_t delta[3]; // added to level every tick while fading
+static uint8_t target[3];
+
+static volatile uint8_t dim = 0;
+static volatile bool partial = false; // an output is neither 0 nor 255
+static const led_pattern_t *beacon = nullptr;
+
+static bool in_between(uint8_t duty) {
+    return duty != 0 && duty != 255;
+}
+
+static uint8_t output(uint16_t value) {
+    uint8_t l = value >> 8;
+    uint8_t duty = ((uint16_t) l * l + 254) / 255;
+    return dim < 8 ? duty >> dim : 0;
+}
+
+/**
+ * writes the current colour out. only called with interrupts off or from the interrupt.
+ */
+static void apply() {
+    uint8_t r = output(level[0]);
+    uint8_t g = output(level[1]);
+    uint8_t b = output(level[2]);
+    hal_status_led(r, g, b);
+    partial = in_between(r) || in_between(g) || in_between(b);
+}
+
+/**
+ * loads steps[index]. only called with interrupts off or from the interrupt.
+ */
+static void load_step(uint8_t index) {
+    const led_step_t *s = &steps[index];
+    step = index;
+    mode = pgm_read_byte(&s->mode);
+    remaining = pgm_read_word(&s->ticks);
+    for (uint8_t c = 0; c < 3; ++c) {
+        target[c] = pgm_read_byte(&s->colour[c]);
+        if (mode == LED_STEP_FADE && remaining > 1) {
+            delta[c] = ((int32_t) target[c] * 256 - level[c]) / remaining;
+        } else {
+            // a one tick fade is a jump. it would also overflow delta.
+            level[c] = target[c] << 8;
+            delta[c] = 0;
+        }
+    }
+    apply();
+}
+
+static void update_timer() {
+    if (steps || partial) {
+        hal_led_timer_start();
+    } else {
+#ifndef BENCH
+        // the bench's cycle counter runs off the same timer.
+        hal_led_timer_stop();
+#endif
+    }
+}
+
+static void play(const led_pattern_t *pattern) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        steps = (const led_step_t *) pgm_read_ptr(&pattern->steps);
+        step_count = pgm_read_byte(&pattern->step_count);
+        repeat_from = pgm_read_byte(&pattern->repeat_from);
+        load_step(0);
+    }
+    update_timer();
+}
+
+static void stop_beacon() {
+    if (beacon) {
+        beacon = nullptr;
+        slow_timer_stop(SLOW_TIMER_LED);
+    }
+}
+
+void leds_init() {
+    hal_leds_init();
+    beacon = nullptr;
+    dim = 0;
+    leds_set(0, 0, 0);
+}
+
+void leds_set(uint8_t r, uint8_t g, uint8_t b) {
+    stop_beacon();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        steps = nullptr;
+        level[0] = r << 8;
+        level[1] = g << 8;
+        level[2] = b << 8;
+        apply();
+    }
+    update_timer();
+}
+
+void leds_play(const led_pattern_t *pattern) {
+    stop_beacon();
+    play(pattern);
+}
+
+void leds_beacon(const led_pattern_t *pattern, unsigned long interval) {
+    beacon = pattern;
+    slow_timer_start(SLOW_TIMER_LED, interval);
+    play(pattern);
+}
+
+void leds_set_dim(uint8_t shift) {
+    dim = shift;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        apply();
+    }
+    update_timer();
+}
+
+void leds_handle(uint8_t event) {
+    // dimmed all the way, a flash would only cost the wake-up.
+    if (event == EVENT_SLOW_TIMER(SLOW_TIMER_LED) && beacon && dim < 8) {
+        play(beacon);
+    }
+}
+
+bool leds_active() {
+    return steps || partial;
+}
+
+void leds_tick() {
+    if (!steps) {
+        return;
+    }
+
+    if (mode == LED_STEP_FADE) {
+        for (uint8_t c = 0; c < 3; ++c) {
+            level[c] += delta[c];
+        }
+        apply();
+    }
+    if (--remaining != 0) {
+        return;
+    }
+
+    // land exactly on the colour, whatever the rounding of delta.
+    for (uint8_t c = 0; c < 3; ++c) {
+        level[c] = target[c] << 8;
+    }
+    uint8_t next = step + 1;
+    if (next < step_count) {
+        load_step(next);
+    } else if (repeat_from != LED_ONCE) {
+        load_step(repeat_from);
+    } else {
+        steps = nullptr;
+        level[0] = level[1] = level[2] = 0;
+        apply();
+        update_timer();
+    }
+}
+
+#ifdef ARDUINO
+ISR(TIMER3_OVF_vect) {
+    BENCH_TIMER_OVERFLOW();
+    hal_led_soft_pwm(true);
+    leds_tick();
+}
+
+ISR(TIMER3_COMPB_vect) {
+    hal_led_soft_pwm(false);
+}
+#endif
@@ -0,0 +1,103 @@
+#include "log.h"
+
+#include "hal.h"
+
+#include <stdarg.h>
+
+static_assert((LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) == 0, "LOG_BUFFER_SIZE must be a power of two");
+static_assert(LOG_BUFFER_SIZE <= 256, "log buffer indices are 8 bit");
+
+static char buffer[LOG_BUFFER_SIZE];
+static uint8_t head = 0; // next byte to write
+static uint8_t tail = 0; // next byte to send
+
+static uint8_t tokens = LOG_BURST;
+static unsigned long last_refill = 0;
+static uint16_t dropped = 0;
+
+static uint8_t buffer_used() {
+    return (head - tail) & (LOG_BUFFER_SIZE - 1);
+}
+
+/**
+ * token bucket. a line costs one token, and one comes back every LOG_RATE_INTERVAL ms up to LOG_BURST.
+ */
+static bool take_token() {
+    unsigned long now = hal_millis();
+    while (tokens < LOG_BURST && now - last_refill >= LOG_RATE_INTERVAL) {
+        ++tokens;
+        last_refill += LOG_RATE_INTERVAL;
+    }
+    if (tokens == LOG_BURST) {
+        last_refill = now;
+    }
+
+    if (tokens == 0) {
+        return false;
+    }
+    --tokens;
+    return true;
+}
+
+void log_printf_P(const char *fmt, ...) {
+    if (!take_token()) {
+        ++dropped;
+        return;
+    }
+
+    char line[LOG_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf_P(line, sizeof(line) - 1, fmt, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+    if (length > (int) sizeof(line) - 2) {
+        length = sizeof(line) - 2;
+    }
+    line[length++] = '\n';
+
+    if (!log_write((const uint8_t *) line, length)) {
+        ++dropped;
+    }
+}
+
+bool log_write(const uint8_t *data, uint8_t length) {
+    // one slot always stays empty to tell a full buffer from an empty one.
+    if (length > LOG_BUFFER_SIZE - 1 - buffer_used()) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; ++i) {
+        buffer[head] = data[i];
+        head = (head + 1) & (LOG_BUFFER_SIZE - 1);
+    }
+    return true;
+}
+
+void log_drain() {
+    if (head == tail || !hal_serial_connected()) {
+        return;
+    }
+
+    int space = hal_serial_write_space();
+    while (space > 0 && head != tail) {
+        // send the contiguous run up to the end of the buffer (or head), then wrap around on the next pass.
+        uint8_t run = head > tail ? head - tail : LOG_BUFFER_SIZE - tail;
+        if (run > space) {
+            run = space;
+        }
+        hal_serial_write((const uint8_t *) &buffer[tail], run);
+        tail = (tail + run) & (LOG_BUFFER_SIZE - 1);
+        space -= run;
+    }
+}
+
+bool log_pending() {
+    return head != tail;
+}
+
+uint16_t log_dropped() {
+    return dropped;
+}
@@ -1,259 +1,354 @@
-
-#include "Arduino.h"
-#include "EEPROM.h"
-#include "TinyStateMachine.h"
-
-#define ALARM_TRIGGERED_ADDRESS 0
-#define BUTTON_PIN 2
-#define KICKSTAND_PIN 3
-#define ALARM_PIN 4
-#define RED_PIN 5
-#define GREEN_PIN 6
-#define BLUE_PIN 7
+#include "battery.h"
+#include "bench.h"
+#include "boot.h"
+#include "config.h"
+#include "console.h"
+#include "debounce.h"
+#include "events.h"
+#include "hal.h"
+#include "imu.h"
+#include "leds.h"
+#include "log.h"
+#include "persist.h"
+#include "power.h"
+#include "protocol.h"
+#include "radio.h"
+#include "siren.h"
+#include "state_machine.h"
+#include "states.h"
+#include "stats.h"
+#include "timers.h"
+#include "trace.h"
+#include "watchdog.h"
 
 #define OFF 000, 000, 000
 #define RED 255, 000, 000
 #define GREEN 000, 255, 000
 
-#define ALARM_BEEP_TIME 1000 // time on and off in ms.
-
-TinyStateMachine tsm = TinyStateMachine(10, 20);
+// siren pattern for each value of config.siren_pattern.
+static const siren_pattern_t *const SIREN_PATTERNS[SIREN_CHOICE_COUNT] PROGMEM = {
+        &SIREN_PATTERN_BEEP,
+        &SIREN_PATTERN_ESCALATING,
+        &SIREN_PATTERN_WARBLE,
+};
 
 struct {
     bool alarm_triggered = false;
     unsigned long state_change_time = 0;
 } state_data;
 
+/**
+ * POWER PROFILES, one per battery level (see battery.h). the lower the battery, the less we do, so there is still
+ * enough charge left to start the bike when the owner gets back.
+ */
+struct power_profile_t {
+    uint8_t led_dim; // see leds_set_dim()
+    uint8_t siren_limit; // see siren_set_limit()
+    unsigned long battery_interval; // ms between battery samples
+    unsigned long heartbeat_interval; // ms between radio heartbeats, 0 = none
+};
 
-state_t START_STATE;
-state_t WAIT_FOR_BUTTON_PRESS_STATE;
-state_t WAIT_FOR_KICKSTAND_DOWN_STATE;
-state_t WAIT_FOR_BUTTON_RELEASE_STATE;
-state_t ALARM_ARMED_STATE;
-state_t ALARM_TRIGGERED_STATE;
-state_t WAIT_FOR_KICKSTAND_UP_STATE;
+static const power_profile_t POWER_PROFILES[BATTERY_LEVEL_COUNT] PROGMEM = {
+        {0, 0, BATTERY_SAMPLE_INTERVAL, RADIO_HEARTBEAT_INTERVAL}, // BATTERY_OK
+        {2, 1, BATTERY_SAMPLE_INTERVAL * 4, RADIO_HEARTBEAT_INTERVAL * 3}, // BATTERY_LOW
+        {8, 2, BATTERY_SAMPLE_INTERVAL * 8, 0}, // BATTERY_CRITICAL: leds off, siren at a quarter
+};
+
+static power_profile_t power_profile;
 
 
 /**
  * FORWARD DECLARATIONS
  */
-bool check_button(uint8_t pin);
+uint8_t take_input_snapshot();
 
 void set_status_led(uint8_t r, uint8_t g, uint8_t b);
 
+void apply_power_profile(battery_level_t level);
 
-void setup() {
+state_t initial_state();
 
-    // alarm relay should be pinout,
-    pinMode(ALARM_PIN, OUTPUT);
-    pinMode(KICKSTAND_PIN, INPUT_PULLUP);
-    pinMode(BUTTON_PIN, INPUT_PULLUP);
+void on_watchdog_hang();
 
-    // setup led pins
-    pinMode(RED_PIN, OUTPUT);
-    pinMode(GREEN_PIN, OUTPUT);
-    pinMode(BLUE_PIN, OUTPUT);
-    pinMode(LED_BUILTIN, OUTPUT);
-    Serial.begin(115200);
-
-    state_data.state_change_time = millis();
-    EEPROM.write(ALARM_TRIGGERED_ADDRESS, false);
+bool on_remote(bool arm);
+
+void on_transition(state_t from, state_t to, uint8_t inputs);
+
+
+// START_STATE state. checks if, on last power off, the state had the alarm in the off state or not.
+void start_enter() {
+    state_data.alarm_triggered = persist_value() & PERSIST_ALARM_TRIGGERED;
+    LOG_INFO("STATE START");
+    set_status_led(GREEN); // green just for startup.
+    hal_builtin_led(0);
+}
+
+// WAIT_FOR_BUTTON_PRESS_STATE state. waits for a button press and doesn't do anything.
+// this is the state that the state machine will be in the majority of the time.
+// the led is turned off when entering this state. the cpu sleeps here until the button changes.
+void wait_for_button_press_enter() {
+    set_status_led(OFF);
+    hal_builtin_led(255);
+    LOG_INFO("STATE WAIT_FOR_BUTTON_PRESS_STATE");
+}
+
+
+// WAIT_FOR_KICKSTAND_DOWN_STATE state. called when button is pressed but kickstand isn't down yet.
+// need to turn on the status LED to GREEN for put-down-kickstand in this state.
+void wait_for_kickstand_down_enter() {
+    set_status_led(GREEN);
+    LOG_INFO("STATE WAIT_FOR_KICKSTAND_DOWN_STATE");
+}
+
+
+// WAIT_FOR_BUTTON_RELEASE_STATE state. After kickstand goes down, need to wait for the button to release to start
+// arming the alarm.
+// set the alarm to RED for ARMED.
+void wait_for_button_release_enter() {
+    set_status_led(RED);
+    LOG_INFO("STATE WAIT_FOR_BUTTON_RELEASE_STATE");
+}
+
+
+// ALARM_ARMED_STATE state. Alarm is turned on and ready.
+// state doesn't do anything, but exits when the kickstand is up.
+// led is off in this state, apart from a short beacon flash every few seconds. the cpu sleeps here until the button or
+// kickstand changes.
+void alarm_armed_enter() {
+    leds_beacon(&LED_PATTERN_ARMED, LED_BEACON_INTERVAL); // a short flash now and then, so the owner can see it's armed
+    siren_stop();
+    imu_arm();
+    radio_armed(true);
+    // armed isn't urgent, a power cut goes through START_STATE anyway. it only matters after a brown-out or watchdog
+    // reset, and the watchdog's hang hook writes it out first. a trigger from before a re-arm stays latched.
+    persist_store((persist_value() & PERSIST_ALARM_TRIGGERED) | PERSIST_ALARM_ARMED, false);
+    LOG_INFO("STATE ALARM_ARMED_STATE");
+}
+
+// disarmed, unless we're on our way to ENTRY_DELAY_STATE, which stores the trigger and so cancels this.
+void alarm_armed_exit() {
+    imu_disarm();
+    radio_armed(false);
+    persist_store(0, false);
+}
+
+
+// ALARM_TRIGGERED_STATE state. Alarm has been triggered. Start the siren pattern on enter, the siren timer takes care of
+// the beeping from there. the state timeout is the re-arm time.
+// exit doesn't do anything, we only turn off the alarm when the button is pressed and the kickstand goes up.
+// Not in this state.
+void alarm_triggered_enter() {
+    radio_alert(ALARM_TRIGGERED_STATE, take_input_snapshot()); // first, so the radio boots while everything else runs.
+    siren_play((const siren_pattern_t *) pgm_read_ptr(&SIREN_PATTERNS[config.siren_pattern]));
+    persist_store(PERSIST_ALARM_TRIGGERED, true); // urgent, the trigger has to survive the thief pulling the power.
+    state_data.alarm_triggered = true;
+    set_status_led(OFF); // turn off light so it doesn't drain battery.
+    timer_start(TIMER_STATE_TIMEOUT, config.rearm_time * 1000UL);
+    trace_spill(); // keep the lead-up to the trigger, even if the power gets cut.
+    LOG_INFO("STATE ALARM_TRIGGERED_STATE");
+}
+
+
+// EXIT_DELAY_STATE state. the button was released with the kickstand down. the alarm arms once config.exit_delay
+// seconds have gone by, so the owner can walk away first. the led blinks red meanwhile.
+// nothing is polled while waiting: the state timeout's event is what moves us on.
+void exit_delay_enter() {
+    leds_play(&LED_PATTERN_COUNTDOWN);
+    timer_start(TIMER_STATE_TIMEOUT, config.exit_delay * 1000UL);
+    LOG_INFO("STATE EXIT_DELAY_STATE");
+}
+
+
+// ENTRY_DELAY_STATE state. the kickstand went up (or the bike moved) while armed. the siren waits config.entry_delay
+// seconds, so the owner can disarm quietly with the button. led stays off, no need to tell a thief.
+// the trigger is persisted up front: cutting the power during the delay doesn't get around the alarm.
+void entry_delay_enter() {
+    BENCH_ENTRY_DELAY();
+    persist_store(PERSIST_ALARM_TRIGGERED, true);
+    timer_start(TIMER_STATE_TIMEOUT, config.entry_delay * 1000UL);
+    LOG_INFO("STATE ENTRY_DELAY_STATE");
+}
+
+// disarmed, unless we're on our way to ALARM_TRIGGERED_STATE, which stores the flag again and so cancels this.
+void entry_delay_exit() {
+    persist_store(0, false);
+}
+
+
+// WAIT_FOR_KICKSTAND_UP_STATE state. Alarm is still on (the siren keeps playing), the trigger has to be pressed.
+void wait_for_kickstand_up_enter() {
+    LOG_INFO("STATE WAIT_FOR_KICKSTAND_UP_STATE");
+    set_status_led(RED);
+}
+
+void wait_for_kickstand_up_exit() {
+    siren_stop();
+    radio_clear();
+    persist_store(0, false);
     state_data.alarm_triggered = false;
+}
+
+// every time we enter a state, we update the time when we entered the state, and stop the old state's timeout. the
+// enter actions run at full speed, loop() throttles again once it's idle.
+void every_state_enter() {
+    power_throttle(false);
+    timer_stop(TIMER_STATE_TIMEOUT);
+    state_data.state_change_time = hal_millis();
+    LOG_INFO("Entered new state at: %lu ms", state_data.state_change_time);
+}
 
-    // START_STATE state. checks if, on last power off, the state had the alarm in the off state or not.
-    START_STATE = tsm.add_state_enter([] {
-        state_data.alarm_triggered = EEPROM.read(ALARM_TRIGGERED_ADDRESS);
-        Serial.println("STATE START");
-        set_status_led(GREEN); // green just for startup.
-        analogWrite(LED_BUILTIN, 0);
-    });
-
-    // WAIT_FOR_BUTTON_PRESS_STATE state. waits for a button press and doesn't do anything.
-    // this is the state that the state machine will be in the majority of the time.
-    // the led is turned off when entering this state.
-    WAIT_FOR_BUTTON_PRESS_STATE = tsm.add_state_enter([] {
-        set_status_led(OFF);
-        analogWrite(LED_BUILTIN, 255);
-        Serial.println("STATE WAIT_FOR_BUTTON_PRESS_STATE");
-    });
-
-
-    // WAIT_FOR_KICKSTAND_DOWN_STATE state. called when button is pressed but kickstand isn't down yet.
-    // need to turn on the status LED to GREEN for put-down-kickstand in this state.
-    WAIT_FOR_KICKSTAND_DOWN_STATE = tsm.add_state_enter([] {
-        set_status_led(GREEN);
-        Serial.println("STATE WAIT_FOR_KICKSTAND_DOWN_STATE");
-    });
-
-
-    // WAIT_FOR_BUTTON_RELEASE_STATE state. After kickstand goes down, need to wait for the button to release to arm
-    // the alarm.
-    // set the alarm to RED for ARMED.
-    WAIT_FOR_BUTTON_RELEASE_STATE = tsm.add_state_enter([] {
-        set_status_led(RED);
-        Serial.println("STATE WAIT_FOR_BUTTON_RELEASE_STATE");
-    });
-
-
-    // ALARM_ARMED_STATE state. Alarm is turned on and ready.
-    // state doesn't do anything, but exits when the kickstand is up. LED is turned off when entering this state.
-    // led is off in this state.
-    ALARM_ARMED_STATE = tsm.add_state_enter([] {
-        set_status_led(OFF);
-        digitalWrite(ALARM_PIN, LOW);
-        Serial.println("STATE ALARM_ARMED_STATE");
-    });
-
-
-    // ALARM_TRIGGERED_STATE state. Alarm has been triggered. Play sound on enter, and make it beep in the loop.
-    // exit doesn't do anything, we only turn off the alarm when the button is pressed and the kickstand goes up.
-    // Not in this state.
-    ALARM_TRIGGERED_STATE = tsm.add_state_el(
-            [] {
-                digitalWrite(ALARM_PIN, HIGH);
-                EEPROM.update(ALARM_TRIGGERED_ADDRESS, true);
-                state_data.alarm_triggered = true;
-                set_status_led(OFF); // turn off light so it doesn't drain battery.
-                Serial.println("STATE ALARM_TRIGGERED_STATE");
-            }, [] {
-                auto time_since_start_ms = millis() - state_data.state_change_time;
-                if ((time_since_start_ms / ALARM_BEEP_TIME) % 2 == 0) {
-                    digitalWrite(ALARM_PIN, HIGH);
-                } else {
-                    digitalWrite(ALARM_PIN, LOW);
-                }
-            }
-    );
-
-
-    // WAIT_FOR_KICKSTAND_UP_STATE state. Alarm is still on, the trigger has to be pressed.
-    WAIT_FOR_KICKSTAND_UP_STATE = tsm.add_state_ee(
-            [] {
-                Serial.println("STATE WAIT_FOR_KICKSTAND_UP_STATE");
-                set_status_led(RED);
-            }, [] {
-                digitalWrite(ALARM_PIN, LOW);
-                EEPROM.update(ALARM_TRIGGERED_ADDRESS, false);
-                state_data.alarm_triggered = false;
-            }
-    );
-
-    // every time we enter a state, we update the time when we entered the state.
-    tsm.add_every_state_enter([] {
-        state_data.state_change_time = millis();
-        Serial.println(String("Entered new state at: ") + state_data.state_change_time + " ms");
-    });
-
-    // on startup, transition to alarm if the alarm was triggered on shutdown previously.
-    tsm.add_transition(START_STATE, ALARM_TRIGGERED_STATE, [] {
-        Serial.println("checking START to ALARM_TRIGGERED_STATE");
-        return state_data.alarm_triggered;
-    });
-
-    // on startup, transition to wait for button press if alarm was not triggered on shutdown previously.
-    tsm.add_transition(START_STATE, WAIT_FOR_BUTTON_PRESS_STATE, [] {
-        return !state_data.alarm_triggered;
-    });
-
-    // go to kickstand down state if the button is pressed.
-    // not checking if kickstand is up here. That way, if bike is ready, parked, and button is pressed, it'll go
-    // directly into the armed state.
-    tsm.add_transition(WAIT_FOR_BUTTON_PRESS_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, [] {
-        return check_button(BUTTON_PIN);
-    });
-
-    // if the button is released while kickstand is still up, go back to waiting for button press.
-    tsm.add_transition(WAIT_FOR_KICKSTAND_DOWN_STATE, WAIT_FOR_BUTTON_PRESS_STATE, [] {
-        return !check_button(BUTTON_PIN);
-    });
-
-    // go to waiting for button release state if kickstand goes down after button is pressed.
-    tsm.add_transition(WAIT_FOR_KICKSTAND_DOWN_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, [] {
-        return check_button(KICKSTAND_PIN);
-    });
-
-
-    // if kickstand goes up while waiting for the button to be released, we assume that the user is adjusting the bike
-    // position. Go back to waiting for the kickstand to go down.
-    tsm.add_transition(WAIT_FOR_BUTTON_RELEASE_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, [] {
-        return !check_button(KICKSTAND_PIN);
-    });
-
-    // if button is released and kickstand is still down, we transition to the armed state. Alarm is now armed and dangerous.
-    tsm.add_transition(WAIT_FOR_BUTTON_RELEASE_STATE, ALARM_ARMED_STATE, [] {
-        return !check_button(BUTTON_PIN);
-    });
-
-    // if kickstand goes up while alarm is armed, transition into alarm triggered state
-    tsm.add_transition(ALARM_ARMED_STATE, ALARM_TRIGGERED_STATE, [] {
-        return !check_button(KICKSTAND_PIN);
-    });
-
-    // if button is pressed in alarm armed state, go back to waiting for button release.
-    tsm.add_transition(ALARM_ARMED_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, [] {
-        return check_button(BUTTON_PIN);
-    });
-
-    // if button is pressed while alarm is on, wait for kickstand to go up. Only transition if the kickstand is down.
-    // that way, if someone triggers the alarm, you have to put the kickstand back down before it can be silenced.
-    tsm.add_transition(ALARM_TRIGGERED_STATE, WAIT_FOR_KICKSTAND_UP_STATE, [] {
-        return check_button(BUTTON_PIN) && check_button(KICKSTAND_PIN);
-    });
-
-    // if the alarm is currently triggered, but time (2 min) has gone by since the alarm was triggered and kickstand
-    // is down again, then turn off the alarm and go back to armed state.
-    tsm.add_transition(ALARM_TRIGGERED_STATE, ALARM_ARMED_STATE, [] {
-        auto current_time_ms = millis();
-        auto delta_ms = current_time_ms - state_data.state_change_time;
-        return check_button(KICKSTAND_PIN) && (delta_ms >= 120000); // 120 seconds = 2 min
-    });
-
-    // if kickstand goes up while button is pressed and alarm is on, go to waiting for kickstand down state.
-    tsm.add_transition(WAIT_FOR_KICKSTAND_UP_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, [] {
-        return !check_button(KICKSTAND_PIN);
-    });
-
-    // if button is released while alarm is on and kickstand is still down, go back to alarm state.
-    tsm.add_transition(WAIT_FOR_KICKSTAND_UP_STATE, ALARM_TRIGGERED_STATE, [] {
-        return !check_button(BUTTON_PIN);
-    });
-
-
-    tsm.startup();
+
+#include "state_tables.h" // generated from src/states.graph by tools/state_graph.py
+
+
+void setup() {
+    // alarm relay should be pinout,
+    siren_init();
+    hal_inputs_init();
+
+    // setup led pins
+    leds_init();
+#ifdef BENCH
+    bench_init(); // runs off the led timer
+#endif
+    hal_serial_begin(115200);
+    config_init(); // before anything that reads it
+    console_init();
+    protocol_init(take_input_snapshot, on_remote);
+    debounce_init();
+    timers_init();
+    battery_init();
+    apply_power_profile(battery_level());
+
+    state_data.state_change_time = hal_millis();
+    // persist_init() already ran, in boot_early().
+    imu_init();
+    radio_init();
+    stats_init();
+
+    power_init();
+    watchdog_init(on_watchdog_hang);
+    sm_init(STATES, TRANSITIONS, on_transition, every_state_enter);
+    sm_startup(initial_state());
 }
 
 void loop() {
-    tsm.loop();
+    watchdog_kick();
+    BENCH_LOOP_BEGIN();
+
+    // the machine only steps when something happened. inputs are sampled once per event, so all guards checked for
+    // that event agree on what the switches are doing.
+    uint8_t event;
+    while (event_pop(&event)) {
+        if (event == EVENT_TIMER(TIMER_PERSIST_FLUSH)) {
+            persist_flush();
+            continue;
+        }
+        if (event == EVENT_BATTERY) {
+            apply_power_profile(battery_level());
+            continue;
+        }
+        battery_handle(event);
+        leds_handle(event);
+        imu_handle(event);
+        stats_handle(event);
+        uint8_t inputs = take_input_snapshot();
+        radio_handle(event, sm_state(), inputs);
+        sm_dispatch(event, inputs);
+    }
+
+    trace_poll();
+    stats_poll();
+    console_poll();
+    protocol_poll();
+    log_drain();
+    BENCH_LOOP_END();
+
+    // nothing left to do until an input edge or a timer wakes us up.
+    power_throttle((THROTTLED_STATES >> sm_state() & 1) && !siren_active() && !leds_active() && !radio_busy());
+    power_sleep(timers_active() || siren_active() || leds_active() || radio_busy() || trace_spill_pending() ||
+                stats_pending() || protocol_busy());
 }
 
 
-bool check_button(uint8_t pin) {
+uint8_t take_input_snapshot() {
 
     /*
      * We use input pullup on pins. That means when there is a connection (closure on the pin), we read 0, and when
      * there is no connection (pin is open), we read 1.
      * Buttons are configured to be normally open, and when pressed (kickstand down, button pressed), complete the circuit.
-     * That means they read 0 when open and 1 when closed. Therefore, the actual pin value is the opposite of what we get
-     * from digitalRead()
+     * That means they read 0 when open and 1 when closed. The debouncer already inverts that, so a set bit means closed.
      *
-     * To make sure we're not reading floating values. The switches are always assumed to be open (button not pressed / kickstand up).
-     *
-     * To make sure we're not reading floating values, we check multiple times. Since we use input pullup, when the switch
-     * is open we don't need to check multiple times, only when the switch is closed (otherwise, might get weird values).
+     * Sampling and debouncing happens in the timer interrupt (see debounce.cpp), so the switch bits only need copying.
+     * the optional sensors that aren't fitted get their at-rest value instead, whatever their open pins read.
      */
 
-    const int num_checks = 20;
-    int total_pressed = 0;
+    uint8_t unfitted = ~(config.sensors << DEBOUNCE_SENSORS_SHIFT) & DEBOUNCE_SENSORS;
+    uint8_t inputs = (debounced_inputs & ~unfitted) | (INPUT_SENSORS_AT_REST & unfitted);
+
+    if (state_data.alarm_triggered) {
+        inputs |= INPUT_ALARM_LATCHED;
+    }
+
+    if (imu_tampered()) {
+        inputs |= INPUT_TAMPER;
+    }
 
-    for (int i = 0; i < num_checks; ++i) {
-        total_pressed += !digitalRead(pin);
+    if (timer_expired(TIMER_STATE_TIMEOUT)) {
+        inputs |= INPUT_STATE_TIMEOUT;
     }
 
-    return total_pressed == num_checks;
+    return inputs;
 }
 
 void set_status_led(uint8_t r, uint8_t g, uint8_t b) {
-    analogWrite(RED_PIN, r);
-    analogWrite(GREEN_PIN, g);
-    analogWrite(BLUE_PIN, b);
+    leds_set(r, g, b);
+}
+
+void apply_power_profile(battery_level_t level) {
+    memcpy_P(&power_profile, &POWER_PROFILES[level], sizeof(power_profile));
+    siren_set_limit(power_profile.siren_limit);
+    battery_set_interval(power_profile.battery_interval);
+    radio_set_heartbeat_interval(power_profile.heartbeat_interval);
+    leds_set_dim(power_profile.led_dim);
+}
+
+// START_STATE works out from scratch what to do after a power cut. after a brown-out or a watchdog reset the alarm was
+// running a moment ago, so it goes straight back to arming or sounding, whatever the switches are doing now.
+state_t initial_state() {
+    uint8_t value = persist_value();
+    if (boot_resumed()) {
+        LOG_WARN("reset %02x, resuming %02x", boot_reset_cause(), value);
+        if (value & PERSIST_ALARM_ARMED) {
+            return ALARM_ARMED_STATE;
+        }
+        if (value & PERSIST_ALARM_TRIGGERED) {
+            return ALARM_TRIGGERED_STATE;
+        }
+    }
+    return START_STATE;
+}
+
+// loop() is stuck and the watchdog is about to reset the chip. a state change that is still waiting to be written
+// would be lost with RAM, so write it now: what the alarm was doing is what it resumes after the reset.
+void on_watchdog_hang() {
+    persist_flush();
+}
+
+// ARM / DISARM from the protocol.
+bool on_remote(bool arm) {
+    return arm ? sm_take(ARM_TRANSITIONS, sizeof(ARM_TRANSITIONS) / sizeof(transition_def_t), take_input_snapshot())
+               : sm_take(DISARM_TRANSITIONS, sizeof(DISARM_TRANSITIONS) / sizeof(transition_def_t),
+                         take_input_snapshot());
+}
+
+// every transition goes into the trace, and the ones in STAT_TRANSITIONS into the counters.
+void on_transition(state_t from, state_t to, uint8_t inputs) {
+    trace_record(from, to, inputs);
+    stats_armed(to == ALARM_ARMED_STATE);
+    for (uint8_t i = 0; i < sizeof(STAT_TRANSITIONS) / sizeof(stat_transition_t); ++i) {
+        if (pgm_read_byte(&STAT_TRANSITIONS[i].from) == from && pgm_read_byte(&STAT_TRANSITIONS[i].to) == to) {
+            stats_count(pgm_read_byte(&STAT_TRANSITIONS[i].stat));
+        }
+    }
 }
@@ -0,0 +1,76 @@
+#include "motion.h"
+
+#define MOTION_AXES 3
+#define MOTION_MAX_BATCH 32 // the sensor's FIFO
+
+struct axis_t {
+    int16_t sum;
+    uint32_t squares;
+    uint16_t jerk; // sum of |x[i] - x[i-1]|
+    int8_t last;
+};
+
+static_assert((uint64_t) MOTION_MAX_BATCH * MOTION_MAX_BATCH * 128 * 128 * MOTION_AXES * MOTION_SCORE_ONE <= UINT32_MAX,
+              "a full batch would overflow the 32 bit spread");
+
+static axis_t axes[MOTION_AXES];
+static uint8_t count = 0;
+static uint16_t score = 0;
+
+static void add(axis_t &axis, int8_t value) {
+    if (count > 0) {
+        int16_t delta = value - axis.last;
+        axis.jerk += delta < 0 ? -delta : delta;
+    }
+    axis.last = value;
+    axis.sum += value;
+    axis.squares += (int16_t) value * value;
+}
+
+void motion_reset() {
+    memset(axes, 0, sizeof(axes));
+    count = 0;
+    score = 0;
+}
+
+void motion_add(const imu_sample_t &sample) {
+    if (count == MOTION_MAX_BATCH) {
+        return;
+    }
+    add(axes[0], sample.x);
+    add(axes[1], sample.y);
+    add(axes[2], sample.z);
+    ++count;
+}
+
+uint16_t motion_end_batch() {
+    uint32_t spread = 0; // n^2 * variance, summed over the axes
+    uint32_t jerk = 0;
+    for (uint8_t i = 0; i < MOTION_AXES; ++i) {
+        const axis_t &axis = axes[i];
+        spread += count * axis.squares - (uint32_t) ((int32_t) axis.sum * axis.sum);
+        jerk += axis.jerk;
+    }
+
+    uint32_t batch = 0;
+    if (count > 0) {
+        batch += spread * MOTION_SCORE_ONE / ((uint16_t) count * count);
+    }
+    if (count > 1) {
+        batch += jerk * MOTION_SCORE_ONE / (count - 1);
+    }
+    if (batch > UINT16_MAX) {
+        batch = UINT16_MAX;
+    }
+
+    // exponential average, in 32 bits so the step can't overflow.
+    score = (((uint32_t) score << MOTION_SCORE_SHIFT) - score + batch) >> MOTION_SCORE_SHIFT;
+
+    memset(axes, 0, sizeof(axes));
+    count = 0;
+    return batch;
+}
+
+uint16_t motion_score() {
+    return score;
+}
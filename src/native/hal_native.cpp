@@ -0,0 +1,705 @@
+#include "sim.h"
+
+#include "battery.h"
+#include "boot.h"
+#include "debounce.h"
+#include "eeprom_layout.h"
+#include "events.h"
+#include "imu.h"
+#include "leds.h"
+#include "radio.h"
+#include "siren.h"
+#include "timers.h"
+#include "watchdog.h"
+
+#define SIM_TICK_US TIMER_TICK_US
+#define SIM_SIREN_TICK_US 4
+#define SIM_EEPROM_WRITE_US 3400 // erase + write of one cell
+#define SIM_SERIAL_BUFFER 64
+#define SIM_NEVER UINT64_MAX
+
+static uint64_t wall_us = 0;
+static uint64_t clock_us = 0; // stops in power-down
+static uint64_t deadline_us = 0; // end of the current sim_run()
+
+static bool tick_running = false;
+static uint64_t next_tick_us = 0;
+
+static bool clock_throttled = false; // timing is the same either way, see hal.h
+
+static bool led_timer_running = false;
+static uint64_t next_led_us = 0;
+
+static bool siren_running = false;
+static uint16_t siren_period = 1;
+static uint64_t next_siren_us = 0;
+
+static bool button = false;
+static bool kickstand = false;
+static uint8_t sensors = 0; // closed ones, DEBOUNCE_* bits
+static bool alarm_pin = false;
+static void (*wake_handler)() = nullptr;
+
+static uint16_t battery_voltage = 12600; // mV
+
+static bool usb = false;
+static bool usb_attached = true; // the arduino core attaches before setup()
+static bool serial_echo = false;
+static char serial_rx[SIM_SERIAL_BUFFER];
+static uint8_t serial_rx_head = 0;
+static uint8_t serial_rx_tail = 0;
+
+static uint8_t eeprom[EEPROM_SIZE];
+static bool eeprom_erased = false;
+static uint64_t eeprom_busy_until = 0;
+static uint32_t eeprom_writes = 0;
+
+static uint32_t deep_sleeps = 0;
+
+// watchdog, on wall time like the IMU: it has its own oscillator and runs in power-down. a reset it asks for is
+// carried out by sim_run() / sim_hang() once the current loop() pass or interrupt is done.
+static uint64_t watchdog_next_us = SIM_NEVER;
+static bool watchdog_interrupt = false; // WDIE
+static bool watchdog_reset_pending = false;
+static uint32_t watchdog_resets = 0;
+static uint8_t reset_cause = 0;
+
+// radio module. packets are picked out of the written bytes and counted by type.
+static bool radio_on = false;
+static uint32_t radio_packets[RADIO_PACKET_CLEAR + 1];
+
+/*
+ * LIS3DH, as far as imu.cpp uses it: the output data rate, a FIFO in stream mode with its watermark, and the
+ * wake-on-motion comparator with a latched INT1. samples are taken on wall time, the sensor has its own clock.
+ */
+#define SIM_IMU_FIFO_SIZE 32
+#define SIM_IMU_REGISTERS 0x40
+
+static const uint16_t IMU_RATES[] = {0, 1, 10, 25, 50, 100, 200, 400}; // Hz, by CTRL_REG1 ODR
+
+static uint8_t imu_registers[SIM_IMU_REGISTERS];
+static uint8_t imu_fifo = 0; // samples in the FIFO. the values are made up when read
+static bool imu_wake_latched = false;
+static bool imu_line = false;
+static bool imu_irq_enabled = false;
+static bool imu_moving = false;
+static uint64_t imu_next_us = SIM_NEVER; // wall time of the next sample
+static uint32_t imu_noise = 1;
+
+static uint64_t imu_period_us() {
+    uint8_t odr = imu_registers[0x20] >> 4;
+    return odr > 0 && odr < sizeof(IMU_RATES) / sizeof(IMU_RATES[0]) ? 1000000UL / IMU_RATES[odr] : 0;
+}
+
+/**
+ * recomputes INT1 from the routing in CTRL_REG3. true if it went active, which is what wakes the cpu.
+ */
+static bool imu_update_line() {
+    uint8_t ctrl3 = imu_registers[0x22];
+    uint8_t watermark = imu_registers[0x2E] & 0x1F;
+    bool line = ((ctrl3 & 0x40) && imu_wake_latched) || ((ctrl3 & 0x04) && imu_fifo > watermark);
+    if (line == imu_line) {
+        return false;
+    }
+    imu_line = line;
+    if (imu_irq_enabled) {
+        imu_irq();
+    }
+    return line;
+}
+
+static bool imu_sample() {
+    imu_next_us += imu_period_us();
+    if (imu_fifo < SIM_IMU_FIFO_SIZE) {
+        ++imu_fifo;
+    }
+    if (imu_moving && (imu_registers[0x30] & 0x2A)) {
+        imu_wake_latched = true;
+    }
+    return imu_update_line();
+}
+
+static int8_t imu_axis(int8_t rest) {
+    imu_noise = imu_noise * 1103515245 + 12345;
+    int8_t jitter = (imu_noise >> 16) % (imu_moving ? 41 : 3);
+    return rest + jitter - (imu_moving ? 20 : 1);
+}
+
+static uint8_t imu_read_register(uint8_t reg) {
+    switch (reg) {
+        case 0x0F:
+            return 0x33; // WHO_AM_I
+        case 0x2F: { // FIFO_SRC
+            uint8_t watermark = imu_registers[0x2E] & 0x1F;
+            return (imu_fifo > watermark ? 0x80 : 0) | (imu_fifo == SIM_IMU_FIFO_SIZE ? 0x40 : 0)
+                   | (imu_fifo == 0 ? 0x20 : 0) | (imu_fifo < 0x1F ? imu_fifo : 0x1F);
+        }
+        case 0x31: { // INT1_SRC, reading it clears the latch
+            uint8_t value = imu_wake_latched ? 0x40 : 0;
+            imu_wake_latched = false;
+            imu_update_line();
+            return value;
+        }
+        case 0x29:
+            return imu_axis(0);
+        case 0x2B:
+            return imu_axis(0);
+        case 0x2D: { // OUT_Z_H, the FIFO moves on after it
+            int8_t z = imu_axis(64); // 1 g
+            if (imu_fifo > 0) {
+                --imu_fifo;
+            }
+            imu_update_line();
+            return z;
+        }
+        default:
+            return reg < SIM_IMU_REGISTERS ? imu_registers[reg] : 0;
+    }
+}
+
+static void init_eeprom() {
+    if (!eeprom_erased) {
+        memset(eeprom, 0xFF, sizeof(eeprom));
+        eeprom_erased = true;
+    }
+}
+
+static void watchdog_fire() {
+    watchdog_next_us += (uint64_t) TIMER_SLOW_TICK_MS * 1000;
+    if (!watchdog_interrupt) {
+        watchdog_reset_pending = true;
+        return;
+    }
+    // the interrupt runs and the hardware drops back to reset mode, as on the chip.
+    watchdog_interrupt = false;
+    watchdog_tick();
+}
+
+/**
+ * cpu clock time of the next timer interrupt, SIM_NEVER if none is due. the wall clock ones are converted.
+ */
+static uint64_t next_interrupt_us() {
+    uint64_t next = tick_running ? next_tick_us : SIM_NEVER;
+    if (siren_running && next_siren_us < next) {
+        next = next_siren_us;
+    }
+    if (led_timer_running && next_led_us < next) {
+        next = next_led_us;
+    }
+    if (imu_next_us != SIM_NEVER && imu_next_us - wall_us + clock_us < next) {
+        next = imu_next_us - wall_us + clock_us;
+    }
+    if (watchdog_next_us != SIM_NEVER && watchdog_next_us - wall_us + clock_us < next) {
+        next = watchdog_next_us - wall_us + clock_us;
+    }
+    return next;
+}
+
+/**
+ * lets both clocks run for us microseconds, firing every timer interrupt that falls in that time. stops early if the
+ * watchdog resets the chip.
+ */
+static void run_clock(uint64_t us) {
+    uint64_t end = clock_us + us;
+    for (;;) {
+        uint64_t next = next_interrupt_us();
+        if (next > end) {
+            break;
+        }
+
+        wall_us += next - clock_us;
+        clock_us = next;
+        if (imu_next_us == wall_us) {
+            imu_sample();
+        }
+        if (watchdog_next_us == wall_us) {
+            watchdog_fire();
+            if (watchdog_reset_pending) {
+                return;
+            }
+        }
+        if (tick_running && next_tick_us == next) {
+            next_tick_us += SIM_TICK_US;
+            timers_tick();
+        }
+        if (siren_running && next_siren_us == next) {
+            siren_tick();
+            next_siren_us += (uint64_t) siren_period * SIM_SIREN_TICK_US;
+        }
+        if (led_timer_running && next_led_us == next) {
+            next_led_us += LED_TICK_US;
+            leds_tick();
+        }
+    }
+    wall_us += end - clock_us;
+    clock_us = end;
+}
+
+static void watchdog_reboot() {
+    watchdog_reset_pending = false;
+    ++watchdog_resets;
+    uint64_t deadline = deadline_us;
+    sim_power_on(HAL_RESET_WATCHDOG);
+    deadline_us = deadline;
+}
+
+void sim_run(unsigned long ms) {
+    deadline_us = wall_us + (uint64_t) ms * 1000;
+    while (wall_us < deadline_us) {
+        loop();
+        if (watchdog_reset_pending) {
+            watchdog_reboot();
+        }
+    }
+}
+
+void sim_hang(unsigned long ms) {
+    // loop() doesn't get to run, but the chip is awake, so every interrupt keeps firing.
+    deadline_us = wall_us + (uint64_t) ms * 1000;
+    run_clock(ms * 1000ULL);
+    if (watchdog_reset_pending) {
+        watchdog_reboot();
+    }
+}
+
+void sim_set_motion(bool moving) {
+    imu_moving = moving;
+}
+
+static void reset(uint8_t cause) {
+    clock_us = 0;
+    tick_running = false;
+    siren_running = false;
+    led_timer_running = false;
+    clock_throttled = false;
+    wake_handler = nullptr;
+    alarm_pin = false;
+    usb = false;
+    usb_attached = true;
+    serial_rx_head = serial_rx_tail = 0;
+    eeprom_busy_until = 0;
+    memset(imu_registers, 0, sizeof(imu_registers));
+    imu_fifo = 0;
+    imu_wake_latched = false;
+    imu_line = false;
+    imu_irq_enabled = false;
+    imu_next_us = SIM_NEVER;
+    watchdog_next_us = SIM_NEVER;
+    watchdog_interrupt = false;
+    watchdog_reset_pending = false;
+    reset_cause = cause;
+    radio_on = false;
+}
+
+void sim_power_on(uint8_t cause) {
+    reset(cause);
+
+    // RAM doesn't survive a reset: drop whatever the last run left in the queue. setup() clears the timers.
+    uint8_t event;
+    while (event_pop(&event)) {
+    }
+
+    boot_early(); // .init8 on the board
+    setup();
+}
+
+static void set_switch(bool &position, bool value) {
+    if (position != value) {
+        position = value;
+        if (wake_handler) {
+            wake_handler();
+        }
+    }
+}
+
+void sim_set_button(bool pressed) {
+    set_switch(button, pressed);
+}
+
+void sim_set_kickstand(bool down) {
+    set_switch(kickstand, down);
+}
+
+void sim_set_sensor(uint8_t bit, bool closed) {
+    uint8_t changed = closed ? sensors | bit : sensors & ~bit;
+    if (changed != sensors) {
+        sensors = changed;
+        if (wake_handler) {
+            wake_handler();
+        }
+    }
+}
+
+void sim_set_battery(uint16_t mv) {
+    battery_voltage = mv;
+}
+
+void sim_set_usb(bool connected) {
+    usb = connected;
+}
+
+void sim_set_serial_echo(bool echo) {
+    serial_echo = echo;
+}
+
+void sim_serial_input(const char *text) {
+    sim_serial_input(text, strlen(text));
+}
+
+void sim_serial_input(const char *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t next = (serial_rx_head + 1) % SIM_SERIAL_BUFFER;
+        if (next == serial_rx_tail) {
+            return;
+        }
+        serial_rx[serial_rx_head] = data[i];
+        serial_rx_head = next;
+    }
+}
+
+bool sim_alarm_pin() {
+    return alarm_pin;
+}
+
+uint64_t sim_wall_us() {
+    return wall_us;
+}
+
+uint32_t sim_eeprom_writes() {
+    return eeprom_writes;
+}
+
+uint32_t sim_watchdog_resets() {
+    return watchdog_resets;
+}
+
+uint32_t sim_deep_sleeps() {
+    return deep_sleeps;
+}
+
+uint32_t sim_radio_packets(uint8_t type) {
+    return type <= RADIO_PACKET_CLEAR ? radio_packets[type] : 0;
+}
+
+bool sim_eeprom_load(const char *path) {
+    init_eeprom();
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return true;
+    }
+    bool ok = fread(eeprom, 1, sizeof(eeprom), file) == sizeof(eeprom);
+    fclose(file);
+    return ok;
+}
+
+bool sim_eeprom_save(const char *path) {
+    init_eeprom();
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(eeprom, 1, sizeof(eeprom), file) == sizeof(eeprom);
+    fclose(file);
+    return ok;
+}
+
+
+unsigned long hal_millis() {
+    return clock_us / 1000;
+}
+
+unsigned long hal_micros() {
+    return clock_us;
+}
+
+void hal_inputs_init() {
+}
+
+uint8_t hal_inputs_read() {
+    return (button ? DEBOUNCE_BUTTON : 0) | (kickstand ? DEBOUNCE_KICKSTAND : 0) | sensors;
+}
+
+void hal_alarm_init() {
+    alarm_pin = false;
+}
+
+void hal_alarm_write(bool high) {
+    alarm_pin = high;
+}
+
+void hal_alarm_toggle() {
+    alarm_pin = !alarm_pin;
+}
+
+void hal_siren_timer_init() {
+    siren_running = false;
+}
+
+void hal_siren_timer_period(uint16_t period) {
+    siren_period = period;
+}
+
+void hal_siren_timer_start() {
+    siren_running = true;
+    next_siren_us = clock_us + (uint64_t) siren_period * SIM_SIREN_TICK_US;
+}
+
+void hal_siren_timer_stop() {
+    siren_running = false;
+}
+
+bool hal_siren_timer_running() {
+    return siren_running;
+}
+
+void hal_tick_start() {
+    tick_running = true;
+    next_tick_us = (clock_us / SIM_TICK_US + 1) * SIM_TICK_US;
+}
+
+void hal_watchdog_start() {
+    watchdog_next_us = wall_us + (uint64_t) TIMER_SLOW_TICK_MS * 1000;
+    watchdog_interrupt = true;
+}
+
+void hal_watchdog_rearm() {
+    watchdog_interrupt = true;
+}
+
+void hal_watchdog_reset() {
+    watchdog_next_us = SIM_NEVER;
+    watchdog_reset_pending = true;
+}
+
+uint8_t hal_reset_cause() {
+    uint8_t cause = reset_cause;
+    reset_cause = 0;
+    watchdog_next_us = SIM_NEVER;
+    return cause;
+}
+
+void hal_leds_init() {
+}
+
+void hal_status_led(uint8_t r, uint8_t g, uint8_t b) {
+}
+
+void hal_builtin_led(uint8_t level) {
+}
+
+void hal_led_timer_start() {
+    if (!led_timer_running) {
+        clock_throttled = false;
+        led_timer_running = true;
+        next_led_us = clock_us + LED_TICK_US;
+    }
+}
+
+void hal_led_timer_stop() {
+    led_timer_running = false;
+}
+
+void hal_led_soft_pwm(bool high) {
+}
+
+void hal_wake_init(void (*on_edge)()) {
+    wake_handler = on_edge;
+}
+
+// interrupts only fire from inside hal_sleep() and the sim_set_*() calls, never in the middle of loop().
+void hal_irq_disable() {
+}
+
+void hal_irq_enable() {
+}
+
+void hal_sleep(bool deep) {
+    if (wall_us >= deadline_us) {
+        return;
+    }
+
+    // power-down: the cpu clock stops, and only a switch edge, the IMU or the watchdog wakes us. switches only change
+    // from the script between sim_run() calls, so sleep until one of the others or the end of this one.
+    if (deep) {
+        ++deep_sleeps;
+        for (;;) {
+            uint64_t next = imu_next_us < watchdog_next_us ? imu_next_us : watchdog_next_us;
+            if (next >= deadline_us) {
+                break;
+            }
+            wall_us = next;
+            if (watchdog_next_us == next) {
+                watchdog_fire();
+                return;
+            }
+            if (imu_sample()) {
+                return;
+            }
+        }
+        wall_us = deadline_us;
+        return;
+    }
+
+    // idle: wake on the next timer interrupt, or at the deadline if there is none before it.
+    uint64_t next = next_interrupt_us();
+    uint64_t left = deadline_us - wall_us;
+    run_clock(next == SIM_NEVER || next - clock_us > left ? left : next - clock_us);
+}
+
+uint16_t hal_battery_read() {
+    uint32_t raw = (uint32_t) battery_voltage * BATTERY_DIVIDER_BOTTOM * 1024
+                   / ((uint32_t) BATTERY_REFERENCE_MV * (BATTERY_DIVIDER_TOP + BATTERY_DIVIDER_BOTTOM));
+    return raw < 1023 ? raw : 1023;
+}
+
+void hal_i2c_init() {
+}
+
+bool hal_i2c_write(uint8_t address, uint8_t reg, uint8_t value) {
+    clock_throttled = false;
+    if (address != IMU_ADDRESS) {
+        return false;
+    }
+    reg &= 0x7F;
+    if (reg < SIM_IMU_REGISTERS) {
+        imu_registers[reg] = value;
+    }
+    if (reg == 0x20) {
+        uint64_t period = imu_period_us();
+        imu_next_us = period ? wall_us + period : SIM_NEVER;
+        if (!period) {
+            imu_fifo = 0;
+        }
+    }
+    imu_update_line();
+    return true;
+}
+
+bool hal_i2c_read(uint8_t address, uint8_t reg, uint8_t *data, uint8_t length) {
+    clock_throttled = false;
+    if (address != IMU_ADDRESS) {
+        return false;
+    }
+    bool increment = reg & 0x80;
+    reg &= 0x7F;
+    for (uint8_t i = 0; i < length; ++i) {
+        data[i] = imu_read_register(reg);
+        if (increment) {
+            // the output registers roll over, so a long read walks through the FIFO.
+            reg = reg == 0x2D ? 0x28 : reg + 1;
+        }
+    }
+    return true;
+}
+
+void hal_imu_irq_init() {
+    imu_irq_enabled = true;
+}
+
+bool hal_imu_irq_level() {
+    return imu_line;
+}
+
+void hal_clock_throttle(bool throttled) {
+    clock_throttled = throttled;
+}
+
+bool hal_clock_throttled() {
+    return clock_throttled;
+}
+
+void hal_serial_begin(unsigned long baud) {
+    init_eeprom();
+}
+
+bool hal_usb_vbus() {
+    return usb;
+}
+
+void hal_usb_attach() {
+    usb_attached = true;
+}
+
+void hal_usb_detach() {
+    usb_attached = false;
+}
+
+bool hal_usb_attached() {
+    return usb_attached;
+}
+
+bool hal_usb_configured() {
+    return usb && usb_attached;
+}
+
+bool hal_serial_connected() {
+    return hal_usb_configured();
+}
+
+int hal_serial_available() {
+    return (serial_rx_head - serial_rx_tail + SIM_SERIAL_BUFFER) % SIM_SERIAL_BUFFER;
+}
+
+int hal_serial_read() {
+    if (serial_rx_head == serial_rx_tail) {
+        return -1;
+    }
+    uint8_t c = serial_rx[serial_rx_tail];
+    serial_rx_tail = (serial_rx_tail + 1) % SIM_SERIAL_BUFFER;
+    return c;
+}
+
+int hal_serial_write_space() {
+    return hal_serial_connected() ? SIM_SERIAL_BUFFER : 0;
+}
+
+void hal_serial_write(const uint8_t *data, uint8_t length) {
+    if (hal_serial_connected() && serial_echo) {
+        fwrite(data, 1, length, stdout);
+    }
+}
+
+void hal_serial_write(uint8_t byte) {
+    hal_serial_write(&byte, 1);
+}
+
+uint8_t hal_eeprom_read(uint16_t address) {
+    init_eeprom();
+    return address < EEPROM_SIZE ? eeprom[address] : 0xFF;
+}
+
+void hal_eeprom_update(uint16_t address, uint8_t value) {
+    init_eeprom();
+    if (address < EEPROM_SIZE && eeprom[address] != value) {
+        eeprom[address] = value;
+        eeprom_busy_until = clock_us + SIM_EEPROM_WRITE_US;
+        ++eeprom_writes;
+    }
+}
+
+bool hal_eeprom_ready() {
+    return clock_us >= eeprom_busy_until;
+}
+
+void hal_radio_on(unsigned long baud) {
+    clock_throttled = false;
+    radio_on = true;
+}
+
+void hal_radio_off() {
+    radio_on = false;
+}
+
+void hal_radio_write(const uint8_t *data, uint8_t length) {
+    // the firmware writes one whole packet at a time.
+    if (!radio_on || length < 6 || data[0] != RADIO_SYNC || data[4] != length - 6) {
+        return;
+    }
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < length - 1; ++i) {
+        crc = _crc8_ccitt_update(crc, data[i]);
+    }
+    if (crc == data[length - 1] && data[1] <= RADIO_PACKET_CLEAR) {
+        ++radio_packets[data[1]];
+    }
+}
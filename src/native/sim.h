@@ -0,0 +1,67 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "hal.h"
+
+/**
+ * controls for the simulated hardware behind the native hal (hal_native.cpp). time is virtual: nothing advances
+ * while loop() runs, and sleep jumps straight to the next interrupt, so minutes of alarm behaviour take milliseconds.
+ *
+ * two clocks are kept: wall time, which always runs, and the cpu clock behind millis() / micros(), which stops in
+ * power-down sleep like timer0 does on the chip.
+ */
+
+// the firmware's entry points, in main.cpp.
+void setup();
+
+void loop();
+
+/**
+ * runs loop() until ms of wall time have gone by.
+ */
+void sim_run(unsigned long ms);
+
+/**
+ * resets the simulated chip (cpu clock at 0, timers stopped, no wake handler, RAM gone) and boots it again: the boot
+ * path, then setup(). EEPROM and the switch positions are kept. cause (HAL_RESET_*) is what hal_reset_cause() reports.
+ */
+void sim_power_on(uint8_t cause);
+
+/**
+ * loop() stops for ms of wall time, stuck on something, while the interrupts keep running. ends early if the
+ * watchdog resets the chip, which boots it again.
+ */
+void sim_hang(unsigned long ms);
+
+// switch positions. a change calls the wake handler, as the pin change interrupt would.
+void sim_set_button(bool pressed);
+void sim_set_kickstand(bool down);
+void sim_set_sensor(uint8_t bit, bool closed); // one of DEBOUNCE_SENSORS
+
+// something is shaking the bike, for the simulated IMU.
+void sim_set_motion(bool moving);
+
+// bike battery voltage, in mV, as seen on the battery sense divider. 12600 (full) at start.
+void sim_set_battery(uint16_t mv);
+
+// usb host present with the port open (once the firmware has attached to it, see power.h). serial output is written
+// to stdout with echo on, dropped otherwise.
+void sim_set_usb(bool connected);
+void sim_set_serial_echo(bool echo);
+void sim_serial_input(const char *text);
+void sim_serial_input(const char *data, size_t length); // binary, zeros and all
+
+bool sim_alarm_pin();
+uint64_t sim_wall_us();
+uint32_t sim_eeprom_writes();
+uint32_t sim_deep_sleeps();
+uint32_t sim_watchdog_resets();
+
+// radio packets of a type (RADIO_PACKET_*) that went out with a good crc while the module was powered.
+uint32_t sim_radio_packets(uint8_t type);
+
+// EEPROM image, EEPROM_SIZE bytes. a missing file loads as erased.
+bool sim_eeprom_load(const char *path);
+bool sim_eeprom_save(const char *path);
+
+#endif //SIM_H
@@ -0,0 +1,338 @@
+#include "sim.h"
+
+#include "battery.h"
+#include "debounce.h"
+#include "persist.h"
+#include "protocol.h"
+#include "radio.h"
+#include "siren.h"
+#include "states.h"
+
+#include <chrono>
+#include <stdlib.h>
+
+/**
+ * scenario runner for env:native. reads scripts (files named on the command line, stdin otherwise), one command per
+ * line, # starts a comment:
+ *
+ *   button down|up              press / release the button
+ *   kickstand down|up           put the kickstand down / lift it
+ *   seat|panel|lock on|off      close / open an optional sensor switch: someone on the seat, side panel in place,
+ *                               steering lock engaged. only counts when fitted (the sensors setting, see config.h)
+ *   motion on|off               start / stop moving the bike (the simulated IMU, with -DIMU=1)
+ *   battery <mV>                set the bike battery's voltage
+ *   wait <ms>                   let virtual time run
+ *   usb on|off                  plug a host in (with the port open) / unplug it
+ *   serial <text...>            send the rest of the line and a newline to the console
+ *   frame <hex bytes...>        send a protocol frame (see protocol.h) with this type, seq and data, crc added
+ *   power-cycle                 cut the power and boot again. EEPROM survives, RAM doesn't
+ *   brown-out                   the same, but the chip sees a brown-out reset
+ *   hang <ms>                   loop() gets stuck for ms, which the watchdog should catch
+ *   expect state <NAME>         fail unless the machine is in NAME (e.g. ALARM_ARMED_STATE)
+ *   expect siren on|off         fail unless a siren pattern is / isn't playing
+ *   expect persisted <value>    fail unless persist_value() is value
+ *   expect usb attached|detached
+ *                               fail unless the firmware has the usb controller attached / powered down
+ *   expect clock throttled|full fail unless the cpu clock is divided down / at full speed
+ *   expect battery ok|low|critical
+ *                               fail unless battery_level() is that
+ *   expect watchdog-resets <n>  fail unless the watchdog has reset the chip n times so far
+ *   expect alerts|heartbeats|clears <n>
+ *                               fail unless n radio packets of that type went out so far (with -DRADIO=1)
+ *   repeat <n> ... end          run the enclosed commands n times (may nest)
+ *   random <seed> <steps>       random switch changes and waits, checking that the siren plays exactly while the
+ *                               alarm is triggered
+ *
+ * every switch change is followed by 100 ms so the debouncer settles. options: -v prints the serial output,
+ * -e <file> keeps the EEPROM in file between runs. the exit code is 1 if any expect failed.
+ *
+ * several files run as one script, one after the other. the regression scenarios in test/scenarios each get a run of
+ * their own: tools/scenarios.py, which every env:native build runs.
+ */
+
+#define SIM_SETTLE_TIME 100
+#define SIM_LINE_MAX 256
+#define SIM_MAX_LINES 4096
+#define SIM_MAX_DEPTH 8
+
+#define STATE_NAME(state) #state,
+static const char *const STATE_NAMES[] = {STATE_GRAPH_STATES(STATE_NAME)};
+#undef STATE_NAME
+
+struct script_line_t {
+    const char *file;
+    int number;
+    char text[SIM_LINE_MAX];
+};
+
+static script_line_t lines[SIM_MAX_LINES];
+static int line_count = 0;
+
+static uint32_t commands = 0;
+static uint32_t expects = 0;
+static uint32_t failures = 0;
+
+static void fail(const script_line_t &line, const char *message, const char *actual) {
+    ++failures;
+    fprintf(stderr, "%s:%d: %s (got %s, t=%.3f s)\n", line.file, line.number, message, actual,
+            sim_wall_us() / 1e6);
+}
+
+static const char *state_name(state_t state) {
+    return state < STATE_COUNT ? STATE_NAMES[state] : "?";
+}
+
+static void step_switch(void (*setter)(bool), bool value) {
+    setter(value);
+    sim_run(SIM_SETTLE_TIME);
+}
+
+/**
+ * the siren has to be playing in, and only in, the two states where the alarm is going off.
+ */
+static bool siren_consistent() {
+    state_t state = sm_state();
+    bool alarm = state == ALARM_TRIGGERED_STATE || state == WAIT_FOR_KICKSTAND_UP_STATE;
+    return alarm == siren_active();
+}
+
+static void run_random(const script_line_t &line, unsigned seed, unsigned long steps) {
+    srand(seed);
+    bool button = false;
+    bool kickstand = false;
+    for (unsigned long i = 0; i < steps; ++i) {
+        switch (rand() % 4) {
+            case 0:
+                step_switch(sim_set_button, button = !button);
+                break;
+            case 1:
+                step_switch(sim_set_kickstand, kickstand = !kickstand);
+                break;
+            case 2:
+                sim_run(rand() % 5000);
+                break;
+            default:
+                sim_run(rand() % 200000); // sometimes long enough for the re-arm timeout
+                break;
+        }
+        if (!siren_consistent()) {
+            char actual[80];
+            snprintf(actual, sizeof(actual), "%s with the siren %s, step %lu", state_name(sm_state()),
+                     siren_active() ? "on" : "off", i);
+            fail(line, "siren out of step with the state", actual);
+            return;
+        }
+    }
+}
+
+static void run_expect(const script_line_t &line, const char *what, const char *value) {
+    ++expects;
+    if (strcmp(what, "state") == 0) {
+        if (strcmp(value, state_name(sm_state())) != 0) {
+            fail(line, "wrong state", state_name(sm_state()));
+        }
+    } else if (strcmp(what, "siren") == 0) {
+        if (siren_active() != (strcmp(value, "on") == 0)) {
+            fail(line, "wrong siren state", siren_active() ? "on" : "off");
+        }
+    } else if (strcmp(what, "usb") == 0) {
+        if (hal_usb_attached() != (strcmp(value, "attached") == 0)) {
+            fail(line, "wrong usb state", hal_usb_attached() ? "attached" : "detached");
+        }
+    } else if (strcmp(what, "clock") == 0) {
+        if (hal_clock_throttled() != (strcmp(value, "throttled") == 0)) {
+            fail(line, "wrong clock speed", hal_clock_throttled() ? "throttled" : "full");
+        }
+    } else if (strcmp(what, "persisted") == 0) {
+        char actual[8];
+        snprintf(actual, sizeof(actual), "%u", persist_value());
+        if (persist_value() != atoi(value)) {
+            fail(line, "wrong persisted value", actual);
+        }
+    } else if (strcmp(what, "watchdog-resets") == 0) {
+        char actual[12];
+        snprintf(actual, sizeof(actual), "%u", sim_watchdog_resets());
+        if (sim_watchdog_resets() != (uint32_t) atol(value)) {
+            fail(line, "wrong number of watchdog resets", actual);
+        }
+    } else if (strcmp(what, "battery") == 0) {
+        static const char *const LEVELS[] = {"ok", "low", "critical"};
+        if (strcmp(value, LEVELS[battery_level()]) != 0) {
+            fail(line, "wrong battery level", LEVELS[battery_level()]);
+        }
+    } else if (strcmp(what, "alerts") == 0 || strcmp(what, "heartbeats") == 0 || strcmp(what, "clears") == 0) {
+        uint8_t type = what[0] == 'a' ? RADIO_PACKET_ALERT : what[0] == 'h' ? RADIO_PACKET_HEARTBEATS
+                                                                              : RADIO_PACKET_CLEAR;
+        char actual[12];
+        snprintf(actual, sizeof(actual), "%u", sim_radio_packets(type));
+        if (sim_radio_packets(type) != (uint32_t) atol(value)) {
+            fail(line, "wrong number of radio packets", actual);
+        }
+    } else {
+        fail(line, "unknown expect", what);
+    }
+}
+
+static int find_end(int from) {
+    int depth = 0;
+    for (int i = from; i < line_count; ++i) {
+        char word[16] = "";
+        sscanf(lines[i].text, "%15s", word);
+        if (strcmp(word, "repeat") == 0) {
+            ++depth;
+        } else if (strcmp(word, "end") == 0 && depth-- == 0) {
+            return i;
+        }
+    }
+    return line_count;
+}
+
+/**
+ * runs lines [from, to).
+ */
+static void run_lines(int from, int to, int depth) {
+    for (int i = from; i < to; ++i) {
+        const script_line_t &line = lines[i];
+        char command[32] = "";
+        char arg1[SIM_LINE_MAX] = "";
+        char arg2[SIM_LINE_MAX] = "";
+        if (sscanf(line.text, "%31s %255s %255s", command, arg1, arg2) < 1) {
+            continue;
+        }
+        ++commands;
+
+        if (strcmp(command, "button") == 0) {
+            step_switch(sim_set_button, strcmp(arg1, "down") == 0);
+        } else if (strcmp(command, "kickstand") == 0) {
+            step_switch(sim_set_kickstand, strcmp(arg1, "down") == 0);
+        } else if (strcmp(command, "seat") == 0 || strcmp(command, "panel") == 0 || strcmp(command, "lock") == 0) {
+            uint8_t bit = command[0] == 's' ? DEBOUNCE_SEAT : command[0] == 'p' ? DEBOUNCE_SIDE_PANEL
+                                                                                 : DEBOUNCE_STEERING_LOCK;
+            sim_set_sensor(bit, strcmp(arg1, "on") == 0);
+            sim_run(SIM_SETTLE_TIME);
+        } else if (strcmp(command, "motion") == 0) {
+            sim_set_motion(strcmp(arg1, "on") == 0);
+        } else if (strcmp(command, "battery") == 0) {
+            sim_set_battery(strtoul(arg1, nullptr, 10));
+        } else if (strcmp(command, "wait") == 0) {
+            sim_run(strtoul(arg1, nullptr, 10));
+        } else if (strcmp(command, "usb") == 0) {
+            sim_set_usb(strcmp(arg1, "on") == 0);
+        } else if (strcmp(command, "serial") == 0) {
+            // the whole rest of the line, spaces and all.
+            const char *text = strstr(line.text, "serial") + strlen("serial");
+            text += strspn(text, " \t");
+            sim_serial_input(text);
+            sim_serial_input("\n");
+        } else if (strcmp(command, "frame") == 0) {
+            uint8_t message[PROTOCOL_MESSAGE_MAX];
+            uint8_t length = 0;
+            const char *text = strstr(line.text, "frame") + strlen("frame");
+            char *end;
+            for (unsigned long byte; length < PROTOCOL_MESSAGE_MAX - 1; text = end) {
+                byte = strtoul(text, &end, 16);
+                if (end == text) {
+                    break;
+                }
+                message[length++] = byte;
+            }
+            uint8_t crc = 0;
+            for (uint8_t i = 0; i < length; ++i) {
+                crc = _crc8_ccitt_update(crc, message[i]);
+            }
+            message[length++] = crc;
+            uint8_t frame[PROTOCOL_FRAME_MAX];
+            sim_serial_input((const char *) frame, protocol_frame(message, length, frame));
+        } else if (strcmp(command, "power-cycle") == 0) {
+            sim_power_on(HAL_RESET_POWER_ON);
+        } else if (strcmp(command, "brown-out") == 0) {
+            sim_power_on(HAL_RESET_BROWN_OUT);
+        } else if (strcmp(command, "hang") == 0) {
+            sim_hang(strtoul(arg1, nullptr, 10));
+        } else if (strcmp(command, "expect") == 0) {
+            run_expect(line, arg1, arg2);
+        } else if (strcmp(command, "random") == 0) {
+            run_random(line, strtoul(arg1, nullptr, 10), strtoul(arg2, nullptr, 10));
+        } else if (strcmp(command, "repeat") == 0) {
+            int end = find_end(i + 1);
+            if (depth >= SIM_MAX_DEPTH) {
+                fail(line, "repeat nested too deep", arg1);
+            } else {
+                for (unsigned long n = strtoul(arg1, nullptr, 10); n > 0; --n) {
+                    run_lines(i + 1, end, depth + 1);
+                }
+            }
+            i = end;
+        } else {
+            fail(line, "unknown command", command);
+        }
+    }
+}
+
+static bool load_script(const char *name, FILE *file) {
+    char text[SIM_LINE_MAX];
+    int number = 0;
+    while (fgets(text, sizeof(text), file)) {
+        ++number;
+        char *comment = strchr(text, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        if (line_count == SIM_MAX_LINES) {
+            fprintf(stderr, "%s:%d: script too long\n", name, number);
+            return false;
+        }
+        script_line_t &line = lines[line_count++];
+        line.file = name;
+        line.number = number;
+        strcpy(line.text, text);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *eeprom_file = nullptr;
+    bool loaded = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-v") == 0) {
+            sim_set_serial_echo(true);
+        } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            eeprom_file = argv[++i];
+        } else {
+            FILE *file = fopen(argv[i], "r");
+            if (!file) {
+                fprintf(stderr, "can't open %s\n", argv[i]);
+                return 2;
+            }
+            bool ok = load_script(argv[i], file);
+            fclose(file);
+            if (!ok) {
+                return 2;
+            }
+            loaded = true;
+        }
+    }
+    if (!loaded && !load_script("<stdin>", stdin)) {
+        return 2;
+    }
+    if (eeprom_file && !sim_eeprom_load(eeprom_file)) {
+        fprintf(stderr, "can't read %s\n", eeprom_file);
+        return 2;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    sim_power_on(HAL_RESET_POWER_ON);
+    run_lines(0, line_count, 0);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+    if (eeprom_file && !sim_eeprom_save(eeprom_file)) {
+        fprintf(stderr, "can't write %s\n", eeprom_file);
+        return 2;
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "%u commands, %u expects, %u failed. %.1f s simulated in %ld ms, %u EEPROM writes, %u deep sleeps\n",
+            commands, expects, failures, sim_wall_us() / 1e6, (long) elapsed.count(), sim_eeprom_writes(),
+            sim_deep_sleeps());
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+#include "persist.h"
+
+#include "hal.h"
+
+// crc seed, so that neither an erased (0xFF) nor a zeroed record passes the check.
+#define PERSIST_CRC_SEED 0x5A
+
+struct persist_record_t {
+    uint16_t seq;
+    uint8_t value;
+    uint8_t check;
+};
+
+static_assert(sizeof(persist_record_t) == PERSIST_RECORD_SIZE, "persist_record_t must match PERSIST_RECORD_SIZE");
+
+static uint8_t slot = PERSIST_RECORDS - 1; // slot of the newest record
+static uint16_t seq = 0; // sequence number of the newest record
+static uint8_t stored = 0; // value in the newest record
+static uint8_t current = 0; // value last passed to persist_store()
+static uint16_t writes = 0;
+
+static uint8_t record_check(const persist_record_t &record) {
+    uint8_t crc = PERSIST_CRC_SEED;
+    crc = _crc8_ccitt_update(crc, record.seq & 0xFF);
+    crc = _crc8_ccitt_update(crc, record.seq >> 8);
+    return _crc8_ccitt_update(crc, record.value);
+}
+
+static uint16_t record_address(uint8_t index) {
+    return EEPROM_PERSIST_START + index * PERSIST_RECORD_SIZE;
+}
+
+void persist_init() {
+    slot = PERSIST_RECORDS - 1;
+    seq = 0;
+    stored = 0;
+    bool found = false;
+    for (uint8_t i = 0; i < PERSIST_RECORDS; ++i) {
+        uint16_t address = record_address(i);
+        persist_record_t record;
+        record.seq = hal_eeprom_read(address) | hal_eeprom_read(address + 1) << 8;
+        record.value = hal_eeprom_read(address + 2);
+        record.check = hal_eeprom_read(address + 3);
+        if (record.check != record_check(record)) {
+            continue;
+        }
+
+        // all valid records are within PERSIST_RECORDS of each other, so the signed difference tells newer from
+        // older even after the sequence number wraps.
+        if (!found || (int16_t) (record.seq - seq) > 0) {
+            found = true;
+            slot = i;
+            seq = record.seq;
+            stored = record.value;
+        }
+    }
+    current = stored;
+}
+
+uint8_t persist_value() {
+    return current;
+}
+
+void persist_store(uint8_t value, bool urgent) {
+    current = value;
+    if (value == stored) {
+        timer_stop(TIMER_PERSIST_FLUSH);
+    } else if (urgent) {
+        persist_flush();
+    } else {
+        timer_start(TIMER_PERSIST_FLUSH, PERSIST_COALESCE_TIME);
+    }
+}
+
+void persist_flush() {
+    timer_stop(TIMER_PERSIST_FLUSH);
+    if (current == stored) {
+        return;
+    }
+
+    persist_record_t record;
+    record.seq = seq + 1;
+    record.value = current;
+    record.check = record_check(record);
+
+    uint8_t next = slot + 1 < PERSIST_RECORDS ? slot + 1 : 0;
+    uint16_t address = record_address(next);
+
+    // check byte last: until it lands, the record is invalid and the previous one still counts.
+    hal_eeprom_update(address, record.seq & 0xFF);
+    hal_eeprom_update(address + 1, record.seq >> 8);
+    hal_eeprom_update(address + 2, record.value);
+    hal_eeprom_update(address + 3, record.check);
+
+    slot = next;
+    seq = record.seq;
+    stored = record.value;
+    ++writes;
+}
+
+uint16_t persist_write_count() {
+    return writes;
+}
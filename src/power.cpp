@@ -0,0 +1,81 @@
+#include "power.h"
+
+#include "bench.h"
+#include "debounce.h"
+#include "events.h"
+#include "hal.h"
+#include "imu.h"
+
+static volatile bool wake_pending = false;
+static unsigned long last_wake_time = 0;
+static uint8_t last_sensors = 0; // for telling a sensor's pin change from the IMU's
+
+static void on_wake_edge() {
+    wake_pending = true;
+    BENCH_EDGE();
+}
+
+/**
+ * follows vbus: the usb controller and its pll only run while something is plugged in.
+ */
+static void update_usb() {
+    bool vbus = hal_usb_vbus();
+    if (vbus != hal_usb_attached()) {
+        if (vbus) {
+            hal_clock_throttle(false); // the usb interrupts need the full clock to keep up with the host
+            hal_usb_attach();
+        } else {
+            hal_usb_detach();
+        }
+    }
+}
+
+void power_init() {
+    update_usb(); // the core attached before setup(), plugged in or not
+    last_sensors = hal_inputs_read() & DEBOUNCE_SENSORS;
+    hal_wake_init(on_wake_edge);
+    last_wake_time = hal_millis();
+}
+
+void power_throttle(bool idle) {
+#ifdef BENCH
+    idle = false;
+#endif
+    hal_clock_throttle(idle && !hal_usb_attached());
+}
+
+void power_sleep(bool clock_needed) {
+    update_usb();
+    if (wake_pending) {
+        wake_pending = false;
+        last_wake_time = hal_millis();
+    }
+
+    // power-down stops every timer, including timer0, which runs millis() and the debouncer. so only use it when the
+    // caller doesn't need them, there is no usb host to talk to, and the debouncer has had time to sample the pins
+    // after a wake and isn't watching a switch bounce. otherwise idle sleep, which timer0 wakes us from every ms.
+    bool deep = !clock_needed
+                && !hal_usb_configured()
+                && hal_millis() - last_wake_time >= POWER_SETTLE_TIME
+                && debounce_settled();
+
+    // interrupts are off between the check and the sleep, so an edge or event can't slip in and leave us asleep.
+    hal_irq_disable();
+    if (!wake_pending && !events_pending()) {
+        hal_sleep(deep);
+    }
+    hal_irq_enable();
+}
+
+#ifdef ARDUINO
+// port b's pin change interrupt, shared by the sensors (hal_wake_init()) and the IMU's line (hal_imu_irq_init()). only
+// a sensor changing counts as a wake edge, the IMU posts its own events.
+ISR(PCINT0_vect) {
+    uint8_t sensors = hal_inputs_read() & DEBOUNCE_SENSORS;
+    if (sensors != last_sensors) {
+        last_sensors = sensors;
+        on_wake_edge();
+    }
+    imu_irq();
+}
+#endif
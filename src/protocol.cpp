@@ -0,0 +1,320 @@
+#include "protocol.h"
+
+#include "battery.h"
+#include "boot.h"
+#include "config.h"
+#include "hal.h"
+#include "log.h"
+#include "persist.h"
+#include "state_machine.h"
+#include "stats.h"
+#include "trace.h"
+
+static_assert(PROTOCOL_MESSAGE_MAX < 0xFF, "frames are cobs encoded as a single block");
+static_assert(3 + CONFIG_NAME_MAX - 1 <= PROTOCOL_DATA_MAX, "a READ_CONFIG reply must fit");
+static_assert(3 + TRACE_RECORD_SIZE <= PROTOCOL_DATA_MAX, "a TRACE frame must fit");
+static_assert(9 + 4 + 2 * STAT_COUNT <= PROTOCOL_DATA_MAX, "a READ_STATS reply must fit");
+static_assert(PROTOCOL_FRAME_MAX < LOG_BUFFER_SIZE, "a frame must fit the log buffer");
+
+static protocol_inputs_t take_inputs = nullptr;
+static protocol_remote_t remote_command = nullptr;
+
+// frame being received, still cobs encoded, without its delimiters.
+static uint8_t rx[PROTOCOL_MESSAGE_MAX + 1];
+static uint8_t rx_length = 0;
+static bool rx_in_frame = false;
+static bool rx_overflow = false;
+
+static uint16_t frames_ok = 0;
+static uint16_t frames_bad = 0;
+static uint16_t replies_dropped = 0;
+
+// trace dump progress. the ring can gain a record while the dump goes out, which shifts it by one: the records'
+// timestamps show it, and the host can simply ask again.
+static bool dumping = false;
+static uint8_t dump_seq = 0;
+static uint8_t dump_source = TRACE_SOURCE_RAM;
+static uint8_t dump_count = 0;
+static uint8_t dump_index = 0;
+
+static void put_u16(uint8_t *data, uint16_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *data, uint32_t value) {
+    put_u16(data, value);
+    put_u16(data + 2, value >> 16);
+}
+
+uint8_t protocol_frame(const uint8_t *message, uint8_t length, uint8_t *frame) {
+    uint8_t n = 0;
+    frame[n++] = 0;
+
+    // every zero is replaced by the distance to the next one (or to the end), starting with the overhead byte.
+    uint8_t code_at = n++;
+    uint8_t code = 1;
+    for (uint8_t i = 0; i < length; ++i) {
+        if (message[i] == 0) {
+            frame[code_at] = code;
+            code_at = n++;
+            code = 1;
+        } else {
+            frame[n++] = message[i];
+            ++code;
+        }
+    }
+    frame[code_at] = code;
+
+    frame[n++] = 0;
+    return n;
+}
+
+/**
+ * cobs decodes data[0..length) in place. returns the decoded length, 0 if it isn't valid cobs.
+ */
+static uint8_t unframe(uint8_t *data, uint8_t length) {
+    uint8_t in = 0;
+    uint8_t out = 0;
+    while (in < length) {
+        uint8_t code = data[in++];
+        if (code == 0 || in + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; ++i) {
+            data[out++] = data[in++];
+        }
+        if (code < 0xFF && in < length) {
+            data[out++] = 0;
+        }
+    }
+    return out;
+}
+
+/**
+ * queues one message. false if it didn't fit the log buffer, which isn't counted here: the trace dump just tries
+ * again later.
+ */
+static bool send(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t length) {
+    uint8_t message[PROTOCOL_MESSAGE_MAX];
+    message[0] = type;
+    message[1] = seq;
+    memcpy(message + 2, data, length);
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < 2 + length; ++i) {
+        crc = _crc8_ccitt_update(crc, message[i]);
+    }
+    message[2 + length] = crc;
+
+    uint8_t frame[PROTOCOL_FRAME_MAX];
+    return log_write(frame, protocol_frame(message, 3 + length, frame));
+}
+
+static void reply(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t length) {
+    if (!send(type | PROTOCOL_REPLY, seq, data, length)) {
+        ++replies_dropped;
+    }
+}
+
+static void reply_error(uint8_t type, uint8_t seq, uint8_t code) {
+    const uint8_t data[2] = {type, code};
+    if (!send(PROTOCOL_ERROR, seq, data, sizeof(data))) {
+        ++replies_dropped;
+    }
+}
+
+static void reply_config(uint8_t type, uint8_t seq, uint8_t index) {
+    uint8_t data[3 + CONFIG_NAME_MAX];
+    data[0] = index;
+    put_u16(data + 1, config_get(index));
+    config_name(index, (char *) data + 3);
+    reply(type, seq, data, 3 + strlen((const char *) data + 3));
+}
+
+static void handle(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t length) {
+    switch (type) {
+        case PROTOCOL_GET_STATE: {
+            uint8_t state[10];
+            state[0] = sm_state();
+            state[1] = take_inputs();
+            state[2] = persist_value();
+            state[3] = battery_level();
+            put_u32(state + 4, hal_millis());
+            put_u16(state + 8, persist_write_count());
+            reply(type, seq, state, sizeof(state));
+            return;
+        }
+        case PROTOCOL_ARM:
+        case PROTOCOL_DISARM: {
+            if (!remote_command(type == PROTOCOL_ARM)) {
+                reply_error(type, seq, PROTOCOL_ERROR_REFUSED);
+                return;
+            }
+            uint8_t state = sm_state();
+            reply(type, seq, &state, 1);
+            return;
+        }
+        case PROTOCOL_DUMP_TRACE:
+            if (dumping) {
+                reply_error(type, seq, PROTOCOL_ERROR_BUSY);
+                return;
+            }
+            protocol_dump_trace(seq);
+            return;
+        case PROTOCOL_READ_CONFIG:
+        case PROTOCOL_WRITE_CONFIG: {
+            bool write = type == PROTOCOL_WRITE_CONFIG;
+            if (length != (write ? 4 : 1)) {
+                reply_error(type, seq, PROTOCOL_ERROR_LENGTH);
+                return;
+            }
+            if (data[0] >= config_count()) {
+                reply_error(type, seq, PROTOCOL_ERROR_INDEX);
+                return;
+            }
+            if (write) {
+                if (!config_set(data[0], data[1] | (uint16_t) data[2] << 8)) {
+                    reply_error(type, seq, PROTOCOL_ERROR_VALUE);
+                    return;
+                }
+                if (data[3]) {
+                    config_save();
+                }
+            }
+            reply_config(type, seq, data[0]);
+            return;
+        }
+        case PROTOCOL_READ_STATS: {
+            uint8_t stats[9 + 4 + 2 * STAT_COUNT];
+            stats[0] = boot_reset_cause();
+            put_u16(stats + 1, log_dropped());
+            put_u16(stats + 3, frames_ok);
+            put_u16(stats + 5, frames_bad);
+            put_u16(stats + 7, replies_dropped);
+            put_u32(stats + 9, stats_armed_time());
+            for (uint8_t i = 0; i < STAT_COUNT; ++i) {
+                put_u16(stats + 13 + 2 * i, stats_get(i));
+            }
+            reply(type, seq, stats, sizeof(stats));
+            return;
+        }
+        default:
+            reply_error(type, seq, PROTOCOL_ERROR_UNKNOWN);
+            return;
+    }
+}
+
+static void handle_frame() {
+    uint8_t length = rx_overflow ? 0 : unframe(rx, rx_length);
+    if (length < 3) {
+        ++frames_bad;
+        return;
+    }
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length - 1; ++i) {
+        crc = _crc8_ccitt_update(crc, rx[i]);
+    }
+    if (crc != rx[length - 1]) {
+        ++frames_bad;
+        return;
+    }
+    ++frames_ok;
+    handle(rx[0], rx[1], rx + 2, length - 3);
+}
+
+void protocol_init(protocol_inputs_t inputs, protocol_remote_t remote) {
+    take_inputs = inputs;
+    remote_command = remote;
+    rx_length = 0;
+    rx_in_frame = false;
+    rx_overflow = false;
+    frames_ok = frames_bad = replies_dropped = 0;
+    dumping = false;
+}
+
+bool protocol_receive(uint8_t c, bool *complete) {
+    *complete = false;
+    if (!rx_in_frame) {
+        if (c != 0) {
+            return false;
+        }
+        rx_in_frame = true;
+        rx_length = 0;
+        rx_overflow = false;
+        return true;
+    }
+
+    if (c != 0) {
+        if (rx_length < sizeof(rx)) {
+            rx[rx_length++] = c;
+        } else {
+            rx_overflow = true;
+        }
+        return true;
+    }
+
+    // a zero right after the opening one: the host is resynchronising (or that was the end of a frame we missed the
+    // start of), keep waiting for a frame.
+    if (rx_length == 0 && !rx_overflow) {
+        return true;
+    }
+    rx_in_frame = false;
+    handle_frame();
+    *complete = true;
+    return true;
+}
+
+void protocol_dump_trace(uint8_t seq) {
+    if (dumping) {
+        return;
+    }
+    dumping = true;
+    dump_seq = seq;
+    dump_source = TRACE_SOURCE_RAM;
+    dump_count = trace_count();
+    dump_index = 0;
+}
+
+/**
+ * sends the dump's next frame. false if there was no room for it.
+ */
+static bool dump_next() {
+    uint8_t data[3 + TRACE_RECORD_SIZE];
+    uint8_t length = 2;
+    data[0] = dump_source;
+    data[1] = dump_count;
+    if (dump_count) {
+        data[2] = dump_index;
+        trace_read(dump_source, dump_index, data + 3);
+        length = sizeof(data);
+    }
+    if (!send(PROTOCOL_TRACE, dump_seq, data, length)) {
+        return false;
+    }
+
+    if (dump_count && ++dump_index < dump_count) {
+        return true;
+    }
+    if (dump_source == TRACE_SOURCE_RAM) {
+        dump_source = TRACE_SOURCE_EEPROM;
+        dump_index = 0;
+        if (!trace_spilled(&dump_count)) {
+            dump_count = 0;
+        }
+    } else {
+        dumping = false;
+    }
+    return true;
+}
+
+void protocol_poll() {
+    if (dumping && !hal_serial_connected()) {
+        dumping = false; // nobody to send it to
+    }
+    while (dumping && dump_next()) {
+    }
+}
+
+bool protocol_busy() {
+    return dumping;
+}
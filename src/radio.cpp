@@ -0,0 +1,208 @@
+#include "radio.h"
+
+#include "events.h"
+#include "hal.h"
+#include "log.h"
+#include "timers.h"
+
+#define PENDING_ALERT _BV(0)
+#define PENDING_CLEAR _BV(1)
+#define PENDING_HEARTBEATS _BV(2)
+
+#define PHASE_OFF 0
+#define PHASE_WAKING 1 // powered, waiting RADIO_WAKE_TIME
+#define PHASE_SENDING 2 // packet written, waiting RADIO_AIR_TIME
+
+static_assert(RADIO_PACKET_MAX <= 64, "a packet has to fit Serial1's transmit buffer");
+
+struct heartbeat_t {
+    uint8_t state;
+    uint8_t inputs;
+};
+
+static uint8_t phase = PHASE_OFF;
+
+#if RADIO
+
+static uint8_t pending = 0;
+static uint8_t sequence = 0;
+
+static uint8_t alert_state = 0;
+static uint8_t alert_inputs = 0;
+static uint8_t alert_repeat = 0;
+
+static heartbeat_t heartbeats[RADIO_HEARTBEAT_BATCH];
+static uint8_t heartbeat_count = 0;
+static uint16_t heartbeat_index = 0; // number of the next heartbeat since power on
+static unsigned long heartbeat_interval = RADIO_HEARTBEAT_INTERVAL;
+static bool armed_now = false;
+
+/**
+ * frames payload as a packet and hands it to the uart.
+ */
+static void send(uint8_t type, const uint8_t *payload, uint8_t length) {
+    uint8_t packet[RADIO_PACKET_MAX];
+    uint8_t size = 0;
+    packet[size++] = RADIO_SYNC;
+    packet[size++] = type;
+    packet[size++] = RADIO_DEVICE_ID;
+    packet[size++] = sequence++;
+    packet[size++] = length;
+    memcpy(packet + size, payload, length);
+    size += length;
+
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < size; ++i) {
+        crc = _crc8_ccitt_update(crc, packet[i]);
+    }
+    packet[size++] = crc;
+    hal_radio_write(packet, size);
+}
+
+/**
+ * writes the most important pending packet. an alert goes before everything else.
+ */
+static void send_next() {
+    if (pending & PENDING_ALERT) {
+        pending &= ~PENDING_ALERT;
+        uint8_t payload[] = {alert_state, alert_inputs, alert_repeat};
+        send(RADIO_PACKET_ALERT, payload, sizeof(payload));
+    } else if (pending & PENDING_CLEAR) {
+        pending &= ~PENDING_CLEAR;
+        send(RADIO_PACKET_CLEAR, nullptr, 0);
+    } else {
+        pending &= ~PENDING_HEARTBEATS;
+        uint8_t payload[3 + RADIO_HEARTBEAT_BATCH * sizeof(heartbeat_t)];
+        uint16_t first = heartbeat_index - heartbeat_count;
+        payload[0] = first & 0xFF;
+        payload[1] = first >> 8;
+        payload[2] = heartbeat_count;
+        memcpy(payload + 3, heartbeats, heartbeat_count * sizeof(heartbeat_t));
+        send(RADIO_PACKET_HEARTBEATS, payload, 3 + heartbeat_count * sizeof(heartbeat_t));
+        heartbeat_count = 0;
+    }
+}
+
+/**
+ * powers the module up if something is waiting to go out.
+ */
+static void wake() {
+    if (phase == PHASE_OFF && pending) {
+        hal_radio_on(RADIO_BAUD);
+        phase = PHASE_WAKING;
+        timer_start(TIMER_RADIO, RADIO_WAKE_TIME);
+    }
+}
+
+static void on_phase_timer() {
+    if (phase == PHASE_OFF) {
+        return;
+    }
+    if (pending) {
+        send_next();
+        phase = PHASE_SENDING;
+        timer_start(TIMER_RADIO, RADIO_AIR_TIME);
+    } else {
+        hal_radio_off();
+        phase = PHASE_OFF;
+    }
+}
+
+static void on_heartbeat(uint8_t state, uint8_t inputs) {
+    if (heartbeat_count < RADIO_HEARTBEAT_BATCH) {
+        heartbeats[heartbeat_count++] = {state, inputs};
+    }
+    ++heartbeat_index;
+    if (heartbeat_count == RADIO_HEARTBEAT_BATCH) {
+        pending |= PENDING_HEARTBEATS;
+        wake();
+    }
+}
+
+void radio_init() {
+    phase = PHASE_OFF;
+    pending = 0;
+    heartbeat_count = 0;
+    heartbeat_index = 0;
+    armed_now = false;
+    hal_radio_off();
+}
+
+void radio_alert(uint8_t state, uint8_t inputs) {
+    alert_state = state;
+    alert_inputs = inputs;
+    alert_repeat = 0;
+    pending |= PENDING_ALERT;
+    pending &= ~PENDING_CLEAR;
+    wake();
+    timer_start(TIMER_RADIO_REPEAT, RADIO_ALERT_INTERVAL, true);
+    LOG_DEBUG("radio: alert");
+}
+
+void radio_clear() {
+    timer_stop(TIMER_RADIO_REPEAT);
+    slow_timer_stop(SLOW_TIMER_HEARTBEAT);
+    heartbeat_count = 0;
+    pending = PENDING_CLEAR;
+    wake();
+}
+
+void radio_armed(bool armed) {
+    armed_now = armed;
+    if (armed) {
+        timer_stop(TIMER_RADIO_REPEAT);
+    }
+    if (armed && heartbeat_interval != 0) {
+        slow_timer_start(SLOW_TIMER_HEARTBEAT, heartbeat_interval);
+    } else {
+        slow_timer_stop(SLOW_TIMER_HEARTBEAT);
+    }
+}
+
+void radio_set_heartbeat_interval(unsigned long interval) {
+    heartbeat_interval = interval;
+    if (armed_now) {
+        radio_armed(true);
+    }
+}
+
+void radio_handle(uint8_t event, uint8_t state, uint8_t inputs) {
+    if (event == EVENT_TIMER(TIMER_RADIO)) {
+        on_phase_timer();
+    } else if (event == EVENT_TIMER(TIMER_RADIO_REPEAT)) {
+        if (++alert_repeat > RADIO_ALERT_REPEATS) {
+            timer_stop(TIMER_RADIO_REPEAT);
+            return;
+        }
+        pending |= PENDING_ALERT;
+        wake();
+    } else if (event == EVENT_SLOW_TIMER(SLOW_TIMER_HEARTBEAT)) {
+        on_heartbeat(state, inputs);
+    }
+}
+
+#else
+
+void radio_init() {
+}
+
+void radio_alert(uint8_t state, uint8_t inputs) {
+}
+
+void radio_clear() {
+}
+
+void radio_armed(bool armed) {
+}
+
+void radio_set_heartbeat_interval(unsigned long interval) {
+}
+
+void radio_handle(uint8_t event, uint8_t state, uint8_t inputs) {
+}
+
+#endif
+
+bool radio_busy() {
+    return phase != PHASE_OFF;
+}
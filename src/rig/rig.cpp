@@ -0,0 +1,253 @@
+#include "fast_pin.h"
+#include "pins.h"
+
+/**
+ * stress rig, env:rig: firmware for a second arduino micro that works the switches of a unit under test, so input
+ * storms and long park / unpark runs can go on for hours without anyone at the bench. tools/stress_rig.py runs the
+ * tests, talking to the rig on its usb serial port and to the unit through its protocol (protocol.h).
+ *
+ * wiring, pin for pin with pins.h, grounds joined:
+ *   the rig's BUTTON_PIN, KICKSTAND_PIN, SEAT_PIN, SIDE_PANEL_PIN and STEERING_LOCK_PIN go to the same pins on the
+ *   unit, in place of (or in parallel with) its switches. the rig closes a switch by pulling the line low and opens
+ *   it by letting go, so the unit's pullups do the rest, like a real switch to ground.
+ *   the unit's ALARM_PIN goes to the rig's ALARM_PIN, an input here, to time the siren.
+ *
+ * commands, one per line; every one gets a single line back, "ok ..." or "error ...":
+ *   open|close <switch>            switch: button, kickstand, seat, panel or lock
+ *   storm <switch> <edges> <min us> <max us>
+ *                                  flip the switch edges times, each state held for a random time between min and max
+ *                                  us. an even number of edges leaves it where it was. replies ok <edges> <us taken>
+ *   watch <timeout ms>             wait for ALARM_PIN to go high. replies ok <us>, the time from the rig's last edge
+ *                                  until it did (the unit's latency), or error timeout. ALARM_PIN is watched all
+ *                                  the time, so a siren that started before the command still counts from its start
+ *   siren                          ok 0|1, ALARM_PIN right now
+ *   seed <n>                       restart the storms' random sequence
+ * nothing else happens during a storm or a watch, timing is a busy loop on micros().
+ */
+
+#define RIG_BAUD 115200
+#define RIG_LINE_MAX 48
+#define RIG_EDGES_MAX 1000000UL // a storm this long takes minutes even at its fastest
+
+enum : uint8_t {
+    RIG_BUTTON,
+    RIG_KICKSTAND,
+    RIG_SEAT,
+    RIG_SIDE_PANEL,
+    RIG_STEERING_LOCK,
+    RIG_SWITCH_COUNT
+};
+
+static const char SWITCH_NAMES[RIG_SWITCH_COUNT][10] PROGMEM = {"button", "kickstand", "seat", "panel", "lock"};
+
+static bool closed[RIG_SWITCH_COUNT];
+static unsigned long last_edge_us = 0;
+static bool siren_seen = false; // ALARM_PIN has gone high since the last edge, at siren_us
+static unsigned long siren_us = 0;
+static uint32_t random_state = 1;
+
+static char line[RIG_LINE_MAX];
+static uint8_t line_length = 0;
+static bool line_too_long = false;
+
+template<uint8_t pin>
+static void drive(bool close) {
+    if (close) {
+        FastPin<pin>::low();
+        FastPin<pin>::output();
+    } else {
+        FastPin<pin>::input();
+    }
+}
+
+static void set_switch(uint8_t id, bool close) {
+    switch (id) {
+        case RIG_BUTTON:
+            drive<BUTTON_PIN>(close);
+            break;
+        case RIG_KICKSTAND:
+            drive<KICKSTAND_PIN>(close);
+            break;
+        case RIG_SEAT:
+            drive<SEAT_PIN>(close);
+            break;
+        case RIG_SIDE_PANEL:
+            drive<SIDE_PANEL_PIN>(close);
+            break;
+        case RIG_STEERING_LOCK:
+            drive<STEERING_LOCK_PIN>(close);
+            break;
+    }
+    closed[id] = close;
+    last_edge_us = micros();
+    siren_seen = false;
+}
+
+static void check_siren() {
+    if (!siren_seen && FastPin<ALARM_PIN>::read()) {
+        siren_seen = true;
+        siren_us = micros();
+    }
+}
+
+// xorshift32: cheap, and the same sequence for the same seed, so a failing storm can be run again.
+static uint32_t next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/**
+ * splits off the first space separated word of text: terminates it and returns what comes after, skipping spaces.
+ */
+static char *next_word(char *text) {
+    while (*text && *text != ' ') {
+        ++text;
+    }
+    while (*text == ' ') {
+        *text++ = 0;
+    }
+    return text;
+}
+
+/**
+ * parses a whole word as a decimal number. false if it isn't one.
+ */
+static bool parse_number(const char *word, unsigned long *value) {
+    if (!*word) {
+        return false;
+    }
+    char *end;
+    *value = strtoul(word, &end, 10);
+    return *end == 0;
+}
+
+/**
+ * the switch named by word, RIG_SWITCH_COUNT if there's no such switch.
+ */
+static uint8_t parse_switch(const char *word) {
+    uint8_t id = 0;
+    while (id < RIG_SWITCH_COUNT && strcmp_P(word, SWITCH_NAMES[id]) != 0) {
+        ++id;
+    }
+    return id;
+}
+
+static void storm(uint8_t id, unsigned long edges, unsigned long min_us, unsigned long max_us) {
+    unsigned long start = micros();
+    unsigned long next = start;
+    for (unsigned long i = 0; i < edges; ++i) {
+        next += min_us + next_random() % (max_us - min_us + 1);
+        while ((long) (micros() - next) < 0) {
+            check_siren();
+        }
+        set_switch(id, !closed[id]);
+    }
+    Serial.print(F("ok "));
+    Serial.print(edges);
+    Serial.print(' ');
+    Serial.println(micros() - start);
+}
+
+static void watch(unsigned long timeout_ms) {
+    unsigned long start = millis();
+    for (check_siren(); !siren_seen; check_siren()) {
+        if (millis() - start >= timeout_ms) {
+            Serial.println(F("error timeout"));
+            return;
+        }
+    }
+    Serial.print(F("ok "));
+    Serial.println(siren_us - last_edge_us);
+}
+
+static void run_line() {
+    char *command = line;
+    while (*command == ' ') {
+        ++command;
+    }
+    char *args[4];
+    char *rest = next_word(command);
+    for (uint8_t i = 0; i < 4; ++i) {
+        args[i] = rest;
+        rest = next_word(rest);
+    }
+
+    if (!*command) {
+        return;
+    }
+    if (strcmp_P(command, PSTR("open")) == 0 || strcmp_P(command, PSTR("close")) == 0) {
+        uint8_t id = parse_switch(args[0]);
+        if (id == RIG_SWITCH_COUNT) {
+            Serial.println(F("error no such switch"));
+            return;
+        }
+        set_switch(id, command[0] == 'c');
+        Serial.println(F("ok"));
+    } else if (strcmp_P(command, PSTR("storm")) == 0) {
+        uint8_t id = parse_switch(args[0]);
+        unsigned long edges, min_us, max_us;
+        if (id == RIG_SWITCH_COUNT) {
+            Serial.println(F("error no such switch"));
+        } else if (!parse_number(args[1], &edges) || !parse_number(args[2], &min_us) || !parse_number(args[3], &max_us)
+                   || edges > RIG_EDGES_MAX || min_us > max_us) {
+            Serial.println(F("error bad storm"));
+        } else {
+            storm(id, edges, min_us, max_us);
+        }
+    } else if (strcmp_P(command, PSTR("watch")) == 0) {
+        unsigned long timeout_ms;
+        if (!parse_number(args[0], &timeout_ms)) {
+            Serial.println(F("error bad timeout"));
+            return;
+        }
+        watch(timeout_ms);
+    } else if (strcmp_P(command, PSTR("siren")) == 0) {
+        Serial.println(FastPin<ALARM_PIN>::read() ? F("ok 1") : F("ok 0"));
+    } else if (strcmp_P(command, PSTR("seed")) == 0) {
+        unsigned long seed;
+        if (!parse_number(args[0], &seed) || seed == 0) {
+            Serial.println(F("error bad seed")); // xorshift would stay at 0
+            return;
+        }
+        random_state = seed;
+        Serial.println(F("ok"));
+    } else {
+        Serial.println(F("error unknown command"));
+    }
+}
+
+void setup() {
+    for (uint8_t id = 0; id < RIG_SWITCH_COUNT; ++id) {
+        set_switch(id, false);
+    }
+    FastPin<ALARM_PIN>::input();
+    Serial.begin(RIG_BAUD);
+}
+
+void loop() {
+    check_siren();
+    while (Serial.available()) {
+        int c = Serial.read();
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (line_length < RIG_LINE_MAX - 1) {
+                line[line_length++] = c;
+            } else {
+                line_too_long = true;
+            }
+            continue;
+        }
+        line[line_length] = 0;
+        if (line_too_long) {
+            Serial.println(F("error line too long"));
+        } else {
+            run_line();
+        }
+        line_length = 0;
+        line_too_long = false;
+    }
+}
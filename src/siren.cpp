@@ -0,0 +1,108 @@
+#include "siren.h"
+
+#include "bench.h"
+#include "boot.h"
+#include "hal.h"
+
+static_assert(F_CPU == 16000000UL, "SIREN_TICKS_PER_MS assumes a 16 MHz clock");
+
+
+static const siren_step_t BEEP_STEPS[] PROGMEM = {
+        SIREN_HOLD(SIREN_HIGH, 1000),
+        SIREN_HOLD(SIREN_LOW, 1000),
+};
+const siren_pattern_t SIREN_PATTERN_BEEP PROGMEM = {BEEP_STEPS, sizeof(BEEP_STEPS) / sizeof(siren_step_t), 0};
+
+static const siren_step_t ESCALATING_STEPS[] PROGMEM = {
+        SIREN_HOLD(SIREN_HIGH, 100), SIREN_HOLD(SIREN_LOW, 900),
+        SIREN_HOLD(SIREN_HIGH, 100), SIREN_HOLD(SIREN_LOW, 900),
+        SIREN_HOLD(SIREN_HIGH, 100), SIREN_HOLD(SIREN_LOW, 900),
+        SIREN_HOLD(SIREN_HIGH, 500), SIREN_HOLD(SIREN_LOW, 500),
+        SIREN_HOLD(SIREN_HIGH, 500), SIREN_HOLD(SIREN_LOW, 500),
+        SIREN_HOLD(SIREN_HIGH, 500), SIREN_HOLD(SIREN_LOW, 500),
+        SIREN_HOLD(SIREN_HIGH, 1000),
+};
+const siren_pattern_t SIREN_PATTERN_ESCALATING PROGMEM = {ESCALATING_STEPS, sizeof(ESCALATING_STEPS) / sizeof(siren_step_t), 12};
+
+static const siren_step_t WARBLE_STEPS[] PROGMEM = {
+        SIREN_TONE_HZ(2000, 250),
+        SIREN_TONE_HZ(1400, 250),
+};
+const siren_pattern_t SIREN_PATTERN_WARBLE PROGMEM = {WARBLE_STEPS, sizeof(WARBLE_STEPS) / sizeof(siren_step_t), 0};
+
+
+// only touched by the interrupt while the timer is running.
+static const siren_step_t *volatile steps = nullptr;
+static volatile uint8_t step_count = 0;
+static volatile uint8_t repeat_from = 0;
+static volatile uint8_t step = 0;
+static volatile uint8_t mode = SIREN_LOW;
+static volatile uint16_t remaining = 0;
+static volatile uint8_t limit = 0;
+
+/**
+ * loads steps[index] and applies its level. only called with the timer stopped or from the interrupt.
+ */
+static void load_step(uint8_t index) {
+    const siren_step_t *s = &steps[index];
+    step = index;
+    mode = pgm_read_byte(&s->mode);
+    remaining = pgm_read_word(&s->count);
+    if (mode != SIREN_LOW && limit != 0) {
+        remaining = remaining >> limit ? remaining >> limit : 1;
+    }
+    hal_siren_timer_period(pgm_read_word(&s->period));
+
+    // a tone starts on its high half.
+    hal_alarm_write(mode != SIREN_LOW);
+}
+
+void siren_init() {
+    // a latched alarm already has the pin high from the boot path (boot.h). leave it on until the pattern takes over.
+    if (!boot_alarm_latched()) {
+        hal_alarm_init();
+    }
+    hal_siren_timer_init();
+}
+
+void siren_play(const siren_pattern_t *pattern) {
+    siren_stop();
+
+    steps = (const siren_step_t *) pgm_read_ptr(&pattern->steps);
+    step_count = pgm_read_byte(&pattern->step_count);
+    repeat_from = pgm_read_byte(&pattern->repeat_from);
+    load_step(0);
+    hal_siren_timer_start();
+    BENCH_SIREN_ON();
+}
+
+void siren_set_limit(uint8_t shift) {
+    limit = shift;
+}
+
+void siren_stop() {
+    hal_siren_timer_stop();
+    hal_alarm_write(false);
+}
+
+bool siren_active() {
+    return hal_siren_timer_running();
+}
+
+void siren_tick() {
+    if (--remaining != 0) {
+        if (mode == SIREN_TONE) {
+            hal_alarm_toggle();
+        }
+        return;
+    }
+
+    uint8_t next = step + 1;
+    load_step(next < step_count ? next : repeat_from);
+}
+
+#ifdef ARDUINO
+ISR(TIMER1_COMPA_vect) {
+    siren_tick();
+}
+#endif
@@ -0,0 +1,94 @@
+#include "state_machine.h"
+
+#include "events.h"
+
+static const state_def_t *state_table = nullptr;
+static const transition_def_t *transition_table = nullptr;
+static transition_hook_t transition_hook = nullptr;
+static state_action_t every_enter = nullptr;
+
+static state_t current_state = 0;
+static state_def_t current_def;
+
+static inline bool guard_matches(const transition_def_t *t, uint8_t inputs) {
+    return (inputs & pgm_read_byte(&t->mask)) == pgm_read_byte(&t->value);
+}
+
+static void load_state(state_t state) {
+    current_state = state;
+    memcpy_P(&current_def, &state_table[state], sizeof(current_def));
+}
+
+static void enter(state_t state, uint8_t inputs) {
+    if (transition_hook) {
+        transition_hook(current_state, state, inputs);
+    }
+    load_state(state);
+    if (every_enter) {
+        every_enter();
+    }
+    if (current_def.enter) {
+        current_def.enter();
+    }
+    event_post(EVENT_STATE_ENTERED);
+}
+
+void sm_init(const state_def_t *states, const transition_def_t *transitions, transition_hook_t on_transition,
+             state_action_t every_state_enter) {
+    state_table = states;
+    transition_table = transitions;
+    transition_hook = on_transition;
+    every_enter = every_state_enter;
+}
+
+void sm_startup(state_t initial) {
+    current_state = SM_NO_STATE;
+    enter(initial, 0);
+}
+
+void sm_dispatch(uint8_t event, uint8_t inputs) {
+    if (current_def.event) {
+        current_def.event(event);
+    }
+
+    // only the current state's slice of the table is looked at.
+    const transition_def_t *t = &transition_table[current_def.first_transition];
+    for (uint8_t i = 0; i < current_def.transition_count; ++i, ++t) {
+        if (guard_matches(t, inputs)) {
+            if (current_def.exit) {
+                current_def.exit();
+            }
+            enter(pgm_read_byte(&t->to), inputs);
+            return;
+        }
+    }
+}
+
+bool sm_take(const transition_def_t *transitions, uint8_t count, uint8_t inputs) {
+    const transition_def_t *t = transitions;
+    for (uint8_t i = 0; i < count; ++i, ++t) {
+        if (pgm_read_byte(&t->from) == current_state && guard_matches(t, inputs)) {
+            if (current_def.exit) {
+                current_def.exit();
+            }
+            enter(pgm_read_byte(&t->to), inputs);
+            return true;
+        }
+    }
+    return false;
+}
+
+state_t sm_state() {
+    return current_state;
+}
+
+uint8_t sm_transitions_of(state_t state, uint8_t *count) {
+    state_def_t def;
+    memcpy_P(&def, &state_table[state], sizeof(def));
+    *count = def.transition_count;
+    return def.first_transition;
+}
+
+bool sm_guard(uint8_t transition, uint8_t inputs) {
+    return guard_matches(&transition_table[transition], inputs);
+}
@@ -0,0 +1,145 @@
+// generated by tools/state_graph.py from src/states.graph, edit that instead.
+// only main.cpp includes this, after the state actions.
+
+#ifndef STATE_TABLES_H
+#define STATE_TABLES_H
+
+#include "states.h"
+#include "stats.h"
+
+/**
+ * TRANSITIONS. grouped by from-state, and checked in order within each group (the first match wins).
+ */
+constexpr transition_def_t TRANSITIONS[] PROGMEM = {
+        // on startup, transition to alarm if the alarm was triggered on shutdown previously.
+        {START_STATE, ALARM_TRIGGERED_STATE, WHEN_SET(INPUT_ALARM_LATCHED)},
+
+        // on startup, transition to wait for button press if alarm was not triggered on shutdown previously.
+        {START_STATE, WAIT_FOR_BUTTON_PRESS_STATE, WHEN_CLEAR(INPUT_ALARM_LATCHED)},
+
+        // go to kickstand down state if the button is pressed.
+        // not checking if kickstand is up here. That way, if bike is ready, parked, and button is pressed, it'll go
+        // directly into the armed state.
+        {WAIT_FOR_BUTTON_PRESS_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, WHEN_SET(INPUT_BUTTON)},
+
+        // if the button is released while kickstand is still up, go back to waiting for button press.
+        {WAIT_FOR_KICKSTAND_DOWN_STATE, WAIT_FOR_BUTTON_PRESS_STATE, WHEN_CLEAR(INPUT_BUTTON)},
+
+        // go to waiting for button release state if kickstand goes down after button is pressed.
+        {WAIT_FOR_KICKSTAND_DOWN_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, WHEN_SET(INPUT_KICKSTAND)},
+
+        // if kickstand goes up while waiting for the button to be released, we assume that the user is adjusting the
+        // bike position. Go back to waiting for the kickstand to go down.
+        {WAIT_FOR_BUTTON_RELEASE_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, WHEN_CLEAR(INPUT_KICKSTAND)},
+
+        // if button is released and kickstand is still down, we start the exit delay. Alarm is armed and dangerous
+        // once it runs out.
+        {WAIT_FOR_BUTTON_RELEASE_STATE, EXIT_DELAY_STATE, WHEN_CLEAR(INPUT_BUTTON)},
+
+        // if kickstand goes up while alarm is armed, give the owner the entry delay before triggering.
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, WHEN_CLEAR(INPUT_KICKSTAND)},
+
+        // if the IMU feels the bike being moved with the kickstand still down (lifted onto a van), same again.
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, WHEN_SET(INPUT_TAMPER)},
+
+        // and if one of the optional sensors goes off: someone sits on the bike, takes the side panel off (to get at
+        // the wiring) or forces the steering lock.
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, WHEN_SET(INPUT_SEAT)},
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, WHEN_CLEAR(INPUT_SIDE_PANEL)},
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, WHEN_CLEAR(INPUT_STEERING_LOCK)},
+
+        // if button is pressed in alarm armed state, go back to waiting for button release.
+        {ALARM_ARMED_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, WHEN_SET(INPUT_BUTTON)},
+
+        // if button is pressed while alarm is on, wait for kickstand to go up. Only transition if the kickstand is
+        // down. that way, if someone triggers the alarm, you have to put the kickstand back down before it can be
+        // silenced.
+        {ALARM_TRIGGERED_STATE, WAIT_FOR_KICKSTAND_UP_STATE, WHEN_SET(INPUT_BUTTON | INPUT_KICKSTAND)},
+
+        // if the alarm is currently triggered, but config.rearm_time has gone by since the alarm was triggered and
+        // kickstand is down again, then turn off the alarm and go back to armed state.
+        {ALARM_TRIGGERED_STATE, ALARM_ARMED_STATE, WHEN_SET(INPUT_KICKSTAND | INPUT_STATE_TIMEOUT)},
+
+        // if kickstand goes up while button is pressed and alarm is on, go to waiting for kickstand down state.
+        {WAIT_FOR_KICKSTAND_UP_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, WHEN_CLEAR(INPUT_KICKSTAND)},
+
+        // if button is released while alarm is on and kickstand is still down, go back to alarm state.
+        {WAIT_FOR_KICKSTAND_UP_STATE, ALARM_TRIGGERED_STATE, WHEN_CLEAR(INPUT_BUTTON)},
+
+        // kickstand up during the exit delay: the owner is adjusting the bike, wait for it to go down again.
+        {EXIT_DELAY_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, WHEN_CLEAR(INPUT_KICKSTAND)},
+
+        // button pressed during the exit delay: start over, the delay restarts when it is released.
+        {EXIT_DELAY_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, WHEN_SET(INPUT_BUTTON)},
+
+        // exit delay over, arm.
+        {EXIT_DELAY_STATE, ALARM_ARMED_STATE, WHEN_SET(INPUT_STATE_TIMEOUT)},
+
+        // button pressed during the entry delay: the owner is back. with the kickstand up that goes on to waiting for
+        // it to come down (disarmed), with it down the alarm re-arms when the button is let go.
+        {ENTRY_DELAY_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, WHEN_SET(INPUT_BUTTON)},
+
+        // entry delay over without the button, sound the alarm.
+        {ENTRY_DELAY_STATE, ALARM_TRIGGERED_STATE, WHEN_SET(INPUT_STATE_TIMEOUT)},
+};
+
+static_assert(sm_sorted(TRANSITIONS, sizeof(TRANSITIONS) / sizeof(transition_def_t)),
+              "TRANSITIONS must be grouped by from-state");
+
+// the protocol's ARM (see protocol.h): what releasing the button does, so it needs the kickstand down too, and the
+// exit delay still runs.
+constexpr transition_def_t ARM_TRANSITIONS[] PROGMEM = {
+        {WAIT_FOR_BUTTON_PRESS_STATE, EXIT_DELAY_STATE, WHEN_SET(INPUT_KICKSTAND)},
+};
+
+// the protocol's DISARM, whatever the inputs: only before the siren goes. a triggered alarm is still silenced with
+// the button and the kickstand down.
+constexpr transition_def_t DISARM_TRANSITIONS[] PROGMEM = {
+        {ALARM_ARMED_STATE, WAIT_FOR_BUTTON_PRESS_STATE, 0, 0},
+        {EXIT_DELAY_STATE, WAIT_FOR_BUTTON_PRESS_STATE, 0, 0},
+        {ENTRY_DELAY_STATE, WAIT_FOR_BUTTON_PRESS_STATE, 0, 0},
+};
+
+/**
+ * STATISTICS. the transitions that bump a counter (see stats.h), in any order.
+ */
+struct stat_transition_t {
+    state_t from;
+    state_t to;
+    uint8_t stat;
+};
+
+constexpr stat_transition_t STAT_TRANSITIONS[] PROGMEM = {
+        {EXIT_DELAY_STATE, ALARM_ARMED_STATE, STAT_ARMS},
+        {ALARM_ARMED_STATE, ENTRY_DELAY_STATE, STAT_ENTRY_DELAYS},
+        {ENTRY_DELAY_STATE, WAIT_FOR_BUTTON_RELEASE_STATE, STAT_OWNER_RETURNS},
+        {ENTRY_DELAY_STATE, WAIT_FOR_BUTTON_PRESS_STATE, STAT_OWNER_RETURNS}, // disarmed over the protocol
+        {ENTRY_DELAY_STATE, ALARM_TRIGGERED_STATE, STAT_TRIGGERS},
+        {ALARM_TRIGGERED_STATE, ALARM_ARMED_STATE, STAT_REARMS},
+        {WAIT_FOR_KICKSTAND_UP_STATE, WAIT_FOR_KICKSTAND_DOWN_STATE, STAT_SILENCED},
+};
+
+/**
+ * STATES. indexed by state_t, so the order has to match the enum.
+ */
+constexpr state_def_t STATES[] PROGMEM = {
+        STATE_DEF(TRANSITIONS, START_STATE, start_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, WAIT_FOR_BUTTON_PRESS_STATE, wait_for_button_press_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, WAIT_FOR_KICKSTAND_DOWN_STATE, wait_for_kickstand_down_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, WAIT_FOR_BUTTON_RELEASE_STATE, wait_for_button_release_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, ALARM_ARMED_STATE, alarm_armed_enter, nullptr, alarm_armed_exit),
+        // the state timeout is the re-arm time.
+        STATE_DEF(TRANSITIONS, ALARM_TRIGGERED_STATE, alarm_triggered_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, WAIT_FOR_KICKSTAND_UP_STATE, wait_for_kickstand_up_enter, nullptr,
+                  wait_for_kickstand_up_exit),
+        STATE_DEF(TRANSITIONS, EXIT_DELAY_STATE, exit_delay_enter, nullptr, nullptr),
+        STATE_DEF(TRANSITIONS, ENTRY_DELAY_STATE, entry_delay_enter, nullptr, entry_delay_exit),
+};
+
+static_assert(sizeof(STATES) / sizeof(state_def_t) == STATE_COUNT, "STATES needs one entry per state");
+
+// states that spend their time waiting on a switch or the motion sensor, which the cpu can do at a fraction of its
+// clock (see power_throttle()). the rest run at full speed from the moment they are entered.
+static const uint16_t THROTTLED_STATES = _BV(WAIT_FOR_BUTTON_PRESS_STATE) | _BV(ALARM_ARMED_STATE);
+
+#endif //STATE_TABLES_H
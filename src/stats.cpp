@@ -0,0 +1,148 @@
+#include "stats.h"
+
+#include "eeprom_layout.h"
+#include "events.h"
+#include "hal.h"
+#include "timers.h"
+
+#define STATS_SLOT_SIZE ((EEPROM_STATS_END - EEPROM_STATS_START) / 2)
+#define STATS_HEADER 2 // seq, payload length
+#define STATS_CRC_SEED 0x3C // so that neither an erased nor a zeroed copy passes the check
+
+struct __attribute__((packed)) stats_data_t {
+    uint32_t armed_time; // s
+    uint16_t counts[STAT_COUNT];
+};
+
+#define STATS_IMAGE_SIZE (STATS_HEADER + sizeof(stats_data_t) + 1)
+
+static_assert(STATS_IMAGE_SIZE <= STATS_SLOT_SIZE, "the counters don't fit their EEPROM copy");
+
+static stats_data_t data;
+static bool dirty = false;
+
+// the copy the newest flush went to, and its sequence number. the next flush goes to the other one.
+static uint8_t slot = 1;
+static uint8_t seq = 0;
+
+// flush progress: what's being written (so counting can go on meanwhile), and how many bytes of it are out.
+// STATS_IMAGE_SIZE means idle.
+static stats_data_t image;
+static uint8_t write_offset = STATS_IMAGE_SIZE;
+static uint8_t write_crc = 0;
+
+static uint16_t slot_address(uint8_t index) {
+    return EEPROM_STATS_START + index * STATS_SLOT_SIZE;
+}
+
+/**
+ * true if copy index is intact, with its sequence number and payload length.
+ */
+static bool slot_valid(uint8_t index, uint8_t *slot_seq, uint8_t *length) {
+    uint16_t address = slot_address(index);
+    *slot_seq = hal_eeprom_read(address);
+    *length = hal_eeprom_read(address + 1);
+    if (*length > STATS_SLOT_SIZE - STATS_HEADER - 1) {
+        return false;
+    }
+    uint8_t crc = STATS_CRC_SEED;
+    for (uint8_t i = 0; i < STATS_HEADER + *length; ++i) {
+        crc = _crc8_ccitt_update(crc, hal_eeprom_read(address + i));
+    }
+    return hal_eeprom_read(address + STATS_HEADER + *length) == crc;
+}
+
+void stats_init() {
+    memset(&data, 0, sizeof(data));
+    dirty = false;
+    slot = 1;
+    seq = 0;
+    write_offset = STATS_IMAGE_SIZE;
+
+    // the newer of the two intact copies. they're one flush apart, so the signed difference tells even after seq
+    // wraps.
+    bool found = false;
+    uint8_t length = 0;
+    for (uint8_t i = 0; i < 2; ++i) {
+        uint8_t slot_seq;
+        uint8_t slot_length;
+        if (slot_valid(i, &slot_seq, &slot_length) && (!found || (int8_t) (slot_seq - seq) > 0)) {
+            found = true;
+            slot = i;
+            seq = slot_seq;
+            length = slot_length;
+        }
+    }
+
+    // a shorter copy (older firmware) leaves the newer counters at 0.
+    uint8_t *bytes = (uint8_t *) &data;
+    for (uint8_t i = 0; i < length && i < sizeof(data); ++i) {
+        bytes[i] = hal_eeprom_read(slot_address(slot) + STATS_HEADER + i);
+    }
+
+    stats_count(STAT_BOOTS);
+    slow_timer_stop(SLOW_TIMER_ARMED_TIME);
+    slow_timer_start(SLOW_TIMER_STATS_FLUSH, STATS_FLUSH_INTERVAL);
+}
+
+void stats_count(uint8_t id) {
+    if (data.counts[id] < UINT16_MAX) {
+        ++data.counts[id];
+        dirty = true;
+    }
+}
+
+void stats_armed(bool armed) {
+    if (armed) {
+        slow_timer_start(SLOW_TIMER_ARMED_TIME, TIMER_SLOW_TICK_MS);
+    } else {
+        slow_timer_stop(SLOW_TIMER_ARMED_TIME);
+    }
+}
+
+void stats_handle(uint8_t event) {
+    if (event == EVENT_SLOW_TIMER(SLOW_TIMER_ARMED_TIME)) {
+        data.armed_time += TIMER_SLOW_TICK_MS / 1000;
+        dirty = true;
+    } else if (event == EVENT_SLOW_TIMER(SLOW_TIMER_STATS_FLUSH) && dirty && !stats_pending()) {
+        image = data;
+        dirty = false;
+        slot ^= 1;
+        ++seq;
+        write_offset = 0;
+    }
+}
+
+/**
+ * byte offset of the EEPROM image: [0] seq, [1] length, the counters, crc.
+ */
+static uint8_t image_byte(uint8_t offset) {
+    if (offset == STATS_IMAGE_SIZE - 1) {
+        return write_crc;
+    }
+    uint8_t value = offset == 0 ? seq : offset == 1 ? sizeof(stats_data_t)
+                                                     : ((const uint8_t *) &image)[offset - STATS_HEADER];
+    write_crc = _crc8_ccitt_update(offset == 0 ? STATS_CRC_SEED : write_crc, value);
+    return value;
+}
+
+void stats_poll() {
+    if (!stats_pending() || !hal_eeprom_ready()) {
+        return;
+    }
+    uint8_t value = image_byte(write_offset);
+    hal_eeprom_update(slot_address(slot) + write_offset, value);
+    ++write_offset;
+}
+
+bool stats_pending() {
+    return write_offset < STATS_IMAGE_SIZE;
+}
+
+uint16_t stats_get(uint8_t id) {
+    return data.counts[id];
+}
+
+uint32_t stats_armed_time() {
+    return data.armed_time;
+}
@@ -0,0 +1,190 @@
+#include "timers.h"
+
+#include "debounce.h"
+#include "events.h"
+#include "hal.h"
+
+#define TIMER_RUNNING _BV(0)
+#define TIMER_PERIODIC _BV(1)
+#define TIMER_EXPIRED _BV(2)
+
+#define WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define NO_TIMER 0xFF
+
+static_assert(TIMER_COUNT < NO_TIMER, "timer ids have to fit the wheel's 8 bit links");
+static_assert(TIMER_TICK_US * 125 == 128 * 1000, "the fixed point conversion assumes 1024 us ticks");
+
+struct soft_timer_t {
+    uint32_t turns; // times the wheel has to come round to the slot again before the timer expires
+    uint32_t period; // periodic timers: period in 1/256 ticks
+    uint8_t fraction; // periodic timers: 1/256 ticks carried over from the last period
+    uint8_t slot;
+    uint8_t next; // doubly linked list of the timers in the same slot
+    uint8_t prev;
+    volatile uint8_t flags;
+};
+
+static_assert(TIMER_COUNT <= EVENT_SLOW_TIMER_BASE - EVENT_TIMER_BASE, "timer events overlap the slow timer events");
+
+struct slow_timer_t {
+    uint16_t period; // watchdog ticks, 0 = stopped
+    uint16_t left;
+};
+
+static soft_timer_t timers[TIMER_COUNT];
+static slow_timer_t slow_timers[SLOW_TIMER_COUNT];
+static uint8_t wheel[WHEEL_SLOTS]; // first timer in each slot
+static uint8_t cursor = 0; // slot the last tick processed
+static volatile uint8_t running = 0;
+
+/**
+ * ticks until a one-shot timer of ms expires, rounded up, plus one because the first tick can come at any point in
+ * the current one. ms * 125 / 128 in two halves, so it can't overflow.
+ */
+static uint32_t one_shot_ticks(uint32_t ms) {
+    return (ms >> 7) * 125 + (((ms & 127) * 125 + 127) >> 7) + 1;
+}
+
+static void link(uint8_t id, uint32_t ticks) {
+    soft_timer_t &timer = timers[id];
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    timer.slot = (cursor + ticks) & WHEEL_MASK;
+    timer.turns = (ticks - 1) >> TIMER_WHEEL_BITS;
+
+    // at the head, so a timer re-linked into the slot being processed isn't visited again in the same tick.
+    timer.prev = NO_TIMER;
+    timer.next = wheel[timer.slot];
+    if (timer.next != NO_TIMER) {
+        timers[timer.next].prev = id;
+    }
+    wheel[timer.slot] = id;
+}
+
+static void unlink(uint8_t id) {
+    soft_timer_t &timer = timers[id];
+    if (timer.prev != NO_TIMER) {
+        timers[timer.prev].next = timer.next;
+    } else {
+        wheel[timer.slot] = timer.next;
+    }
+    if (timer.next != NO_TIMER) {
+        timers[timer.next].prev = timer.prev;
+    }
+}
+
+/**
+ * next period of a periodic timer in whole ticks, keeping the remainder for the one after.
+ */
+static uint32_t next_period(soft_timer_t &timer) {
+    uint32_t q8 = timer.period + timer.fraction;
+    timer.fraction = q8 & 0xFF;
+    return q8 >> 8;
+}
+
+void timers_init() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memset(wheel, NO_TIMER, sizeof(wheel));
+        for (uint8_t i = 0; i < TIMER_COUNT; ++i) {
+            timers[i].flags = 0;
+        }
+        running = 0;
+        memset(slow_timers, 0, sizeof(slow_timers));
+    }
+    hal_tick_start();
+}
+
+void timer_start(uint8_t id, unsigned long duration, bool periodic) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        soft_timer_t &timer = timers[id];
+        if (timer.flags & TIMER_RUNNING) {
+            unlink(id);
+        } else {
+            ++running;
+        }
+
+        if (periodic) {
+            timer.period = (uint32_t) (duration < TIMER_PERIOD_MAX ? duration : TIMER_PERIOD_MAX) * 250;
+            timer.fraction = 0;
+            link(id, next_period(timer));
+        } else {
+            link(id, one_shot_ticks(duration));
+        }
+        timer.flags = TIMER_RUNNING | (periodic ? TIMER_PERIODIC : 0);
+    }
+}
+
+void timer_stop(uint8_t id) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (timers[id].flags & TIMER_RUNNING) {
+            unlink(id);
+            --running;
+        }
+        timers[id].flags = 0;
+    }
+}
+
+bool timer_expired(uint8_t id) {
+    return timers[id].flags & TIMER_EXPIRED;
+}
+
+bool timers_active() {
+    return running != 0;
+}
+
+void slow_timer_start(uint8_t id, unsigned long period) {
+    unsigned long ticks = (period + TIMER_SLOW_TICK_MS - 1) / TIMER_SLOW_TICK_MS;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        slow_timers[id].period = ticks == 0 ? 1 : ticks < UINT16_MAX ? ticks : UINT16_MAX;
+        slow_timers[id].left = slow_timers[id].period;
+    }
+}
+
+void slow_timer_stop(uint8_t id) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        slow_timers[id].period = 0;
+    }
+}
+
+void slow_timers_tick() {
+    for (uint8_t i = 0; i < SLOW_TIMER_COUNT; ++i) {
+        slow_timer_t &timer = slow_timers[i];
+        if (timer.period != 0 && --timer.left == 0) {
+            timer.left = timer.period;
+            event_post(EVENT_SLOW_TIMER(i));
+        }
+    }
+}
+
+void timers_tick() {
+    debounce_tick();
+
+    cursor = (cursor + 1) & WHEEL_MASK;
+    uint8_t id = wheel[cursor];
+    while (id != NO_TIMER) {
+        soft_timer_t &timer = timers[id];
+        uint8_t next = timer.next;
+        if (timer.turns != 0) {
+            --timer.turns;
+        } else {
+            unlink(id);
+            if (timer.flags & TIMER_PERIODIC) {
+                link(id, next_period(timer));
+            } else {
+                timer.flags = TIMER_EXPIRED;
+                --running;
+            }
+            event_post(EVENT_TIMER(id));
+        }
+        id = next;
+    }
+}
+
+#ifdef ARDUINO
+// timer0 compare B, see hal_tick_start().
+ISR(TIMER0_COMPB_vect) {
+    timers_tick();
+}
+#endif
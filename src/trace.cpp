@@ -0,0 +1,134 @@
+#include "trace.h"
+
+#include "eeprom_layout.h"
+#include "hal.h"
+
+/*
+ * EEPROM copy: magic, count, count records, crc8 over count and the records. the magic byte is cleared first and only
+ * written back once everything else has landed, so a spill cut short by a power loss is never mistaken for a good one.
+ */
+#define TRACE_SPILL_MAGIC 0xA7
+#define TRACE_SPILL_SIZE (2 + TRACE_RECORDS * TRACE_RECORD_SIZE + 1)
+
+static_assert(EEPROM_TRACE_START + TRACE_SPILL_SIZE <= EEPROM_TRACE_END, "trace spill doesn't fit its EEPROM area");
+
+struct __attribute__((packed)) trace_record_t {
+    uint32_t time;
+    state_t from;
+    state_t to;
+    uint8_t inputs;
+};
+
+static_assert(sizeof(trace_record_t) == TRACE_RECORD_SIZE, "trace_record_t must match TRACE_RECORD_SIZE");
+
+static trace_record_t records[TRACE_RECORDS];
+static uint8_t next = 0; // slot the next record goes into
+static uint8_t count = 0;
+
+// spill progress. spill_offset counts bytes of the EEPROM image written so far, TRACE_SPILL_SIZE + 1 means idle.
+static uint16_t spill_offset = TRACE_SPILL_SIZE + 1;
+static uint8_t spill_first = 0;
+static uint8_t spill_count = 0;
+static uint8_t spill_crc = 0;
+
+static uint8_t oldest() {
+    return (next + TRACE_RECORDS - count) % TRACE_RECORDS;
+}
+
+void trace_record(state_t from, state_t to, uint8_t inputs) {
+    trace_record_t &record = records[next];
+    record.time = hal_micros();
+    record.from = from;
+    record.to = to;
+    record.inputs = inputs;
+
+    next = (next + 1) % TRACE_RECORDS;
+    if (count < TRACE_RECORDS) {
+        ++count;
+    }
+}
+
+void trace_spill() {
+#if TRACE_SPILL
+    if (trace_spill_pending()) {
+        return;
+    }
+    spill_first = oldest();
+    spill_count = count;
+    spill_offset = 0;
+#endif
+}
+
+bool trace_spill_pending() {
+    return spill_offset <= TRACE_SPILL_SIZE;
+}
+
+/**
+ * byte offset of the EEPROM image: [0] magic, [1] count, records, crc. the magic byte is written twice, cleared at
+ * offset 0 and set at offset TRACE_SPILL_SIZE.
+ */
+static uint8_t spill_byte(uint16_t offset, uint16_t *address) {
+    if (offset == 0 || offset == TRACE_SPILL_SIZE) {
+        *address = EEPROM_TRACE_START;
+        return offset == 0 ? 0xFF : TRACE_SPILL_MAGIC;
+    }
+
+    *address = EEPROM_TRACE_START + offset;
+    uint8_t value;
+    if (offset == 1) {
+        value = spill_count;
+        spill_crc = _crc8_ccitt_update(0, value);
+    } else if (offset == TRACE_SPILL_SIZE - 1) {
+        return spill_crc;
+    } else {
+        uint16_t index = offset - 2;
+        uint8_t record = index / TRACE_RECORD_SIZE;
+        // slots past spill_count are padding, their content doesn't matter but still goes into the crc.
+        const uint8_t *bytes = (const uint8_t *) &records[(spill_first + record) % TRACE_RECORDS];
+        value = bytes[index % TRACE_RECORD_SIZE];
+        spill_crc = _crc8_ccitt_update(spill_crc, value);
+    }
+    return value;
+}
+
+void trace_poll() {
+    if (!trace_spill_pending() || !hal_eeprom_ready()) {
+        return;
+    }
+
+    uint16_t address;
+    uint8_t value = spill_byte(spill_offset, &address);
+    hal_eeprom_update(address, value);
+    ++spill_offset;
+}
+
+uint8_t trace_count() {
+    return count;
+}
+
+bool trace_spilled(uint8_t *n) {
+    // only a copy that is complete and intact counts.
+    if (hal_eeprom_read(EEPROM_TRACE_START) != TRACE_SPILL_MAGIC) {
+        return false;
+    }
+    *n = hal_eeprom_read(EEPROM_TRACE_START + 1);
+    if (*n > TRACE_RECORDS) {
+        return false;
+    }
+    uint8_t crc = 0;
+    for (uint16_t offset = 1; offset < TRACE_SPILL_SIZE - 1; ++offset) {
+        crc = _crc8_ccitt_update(crc, hal_eeprom_read(EEPROM_TRACE_START + offset));
+    }
+    return crc == hal_eeprom_read(EEPROM_TRACE_START + TRACE_SPILL_SIZE - 1);
+}
+
+void trace_read(uint8_t source, uint8_t index, uint8_t *record) {
+    if (source == TRACE_SOURCE_EEPROM) {
+        uint16_t address = EEPROM_TRACE_START + 2 + index * TRACE_RECORD_SIZE;
+        for (uint8_t b = 0; b < TRACE_RECORD_SIZE; ++b) {
+            record[b] = hal_eeprom_read(address + b);
+        }
+    } else {
+        memcpy(record, &records[(oldest() + index) % TRACE_RECORDS], TRACE_RECORD_SIZE);
+    }
+}
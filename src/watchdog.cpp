@@ -0,0 +1,37 @@
+#include "watchdog.h"
+
+#include "hal.h"
+#include "timers.h"
+
+static volatile bool kicked = false;
+static watchdog_hook_t hang_hook = nullptr;
+
+void watchdog_init(watchdog_hook_t on_hang) {
+    hang_hook = on_hang;
+    kicked = true; // setup() counts as the first pass
+    hal_watchdog_start();
+}
+
+void watchdog_kick() {
+    kicked = true;
+}
+
+void watchdog_tick() {
+    if (!kicked) {
+        if (hang_hook) {
+            hang_hook();
+        }
+        hal_watchdog_reset();
+        return;
+    }
+    kicked = false;
+    hal_watchdog_rearm();
+    slow_timers_tick();
+}
+
+#ifdef ARDUINO
+// see hal_watchdog_start().
+ISR(WDT_vect) {
+    watchdog_tick();
+}
+#endif
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+Flash and SRAM footprint of a firmware build, per section and per symbol, checked against a budget.
+
+Runs after every board build as a PlatformIO extra script (see platformio.ini): writes footprint.txt next to
+firmware.elf, prints the totals, and fails the build when either goes over its budget (custom_flash_budget /
+custom_sram_budget in the env). Or by hand on any elf:
+    python3 tools/footprint.py .pio/build/micro/firmware.elf --flash-budget 28672 --sram-budget 2048
+
+flash is .text (code, vector table, PROGMEM) plus .data (initial values, copied to SRAM at boot). static SRAM is
+.data, .bss and .noinit; the stack gets what's left of the 32U4's 2560 bytes, so the SRAM budget has to leave room
+for it.
+"""
+
+import argparse
+import subprocess
+import sys
+
+SRAM_OFFSET = 0x800000  # avr-gcc puts data addresses here to tell them from flash
+FLASH_SECTIONS = (".text", ".data")
+SRAM_SECTIONS = (".data", ".bss", ".noinit")
+
+
+def section_sizes(elf, size_tool):
+    out = subprocess.run([size_tool, "-A", elf], check=True, capture_output=True, text=True).stdout
+    sizes = {}
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def symbols(elf, nm_tool):
+    """(size, region, type, name) for every sized symbol, region 'flash' or 'sram'."""
+    out = subprocess.run([nm_tool, "--print-size", "--size-sort", "--demangle", elf],
+                         check=True, capture_output=True, text=True).stdout
+    result = []
+    for line in out.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) < 4:
+            continue
+        address, size, kind, name = int(fields[0], 16), int(fields[1], 16), fields[2], fields[3]
+        result.append((size, "sram" if address >= SRAM_OFFSET else "flash", kind, name))
+    result.sort(reverse=True)
+    return result
+
+
+def report(elf, size_tool, nm_tool, flash_budget, sram_budget, top):
+    """the report as a list of lines, and whether it stays within budget."""
+    sizes = section_sizes(elf, size_tool)
+    flash = sum(sizes.get(s, 0) for s in FLASH_SECTIONS)
+    sram = sum(sizes.get(s, 0) for s in SRAM_SECTIONS)
+
+    lines = []
+    ok = True
+    for label, used, budget in (("flash", flash, flash_budget), ("sram", sram, sram_budget)):
+        if budget:
+            over = used > budget
+            ok &= not over
+            lines.append("%-5s %6u of %6u bytes budget (%5.1f%%)%s"
+                         % (label, used, budget, 100.0 * used / budget, "  OVER BUDGET" if over else ""))
+        else:
+            lines.append("%-5s %6u bytes" % (label, used))
+    lines.append("sections: " + ", ".join("%s %u" % (s, n) for s, n in sorted(sizes.items()) if n))
+
+    all_symbols = symbols(elf, nm_tool)
+    for region in ("flash", "sram"):
+        region_symbols = [s for s in all_symbols if s[1] == region]
+        lines.append("")
+        lines.append("largest %s symbols:" % region)
+        for size, _, kind, name in region_symbols[:top]:
+            lines.append("  %6u %s %s" % (size, kind, name))
+    return lines, ok
+
+
+def platformio_post_build(env):
+    """extra script entry point: checks firmware.elf after it's linked."""
+    def option(name):
+        value = env.GetProjectOption(name, "")
+        return int(value, 0) if value else 0
+
+    def check(target, source, env):
+        elf = target[0].get_abspath()
+        size_tool = env.subst("$SIZETOOL")
+        nm_tool = size_tool.replace("size", "nm")
+        lines, ok = report(elf, size_tool, nm_tool, option("custom_flash_budget"), option("custom_sram_budget"),
+                           option("custom_footprint_top") or 20)
+        path = env.subst("$BUILD_DIR/footprint.txt")
+        with open(path, "w") as f:
+            f.write("\n".join(lines) + "\n")
+        print("\n".join(lines[:2]))
+        print("footprint per symbol: %s" % path)
+        if not ok:
+            print("footprint over budget", file=sys.stderr)
+        return 0 if ok else 1
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="linked firmware, e.g. .pio/build/micro/firmware.elf")
+    parser.add_argument("--flash-budget", type=lambda s: int(s, 0), default=0, help="bytes, 0 for no check")
+    parser.add_argument("--sram-budget", type=lambda s: int(s, 0), default=0, help="static bytes, 0 for no check")
+    parser.add_argument("--top", type=int, default=20, help="symbols to list per region")
+    parser.add_argument("--size-tool", default="avr-size")
+    parser.add_argument("--nm-tool", default="avr-nm")
+    args = parser.parse_args()
+
+    lines, ok = report(args.elf, args.size_tool, args.nm_tool, args.flash_budget, args.sram_budget, args.top)
+    print("\n".join(lines))
+    return 0 if ok else 1
+
+
+try:
+    Import("env")  # noqa: F821, only defined when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    platformio_post_build(env)  # noqa: F821
@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+"""
+Host side of the binary protocol in include/protocol.h: talks to a board over its usb serial port (needs pyserial).
+
+    python3 tools/protocol.py --port /dev/ttyACM0 state
+    python3 tools/protocol.py --port /dev/ttyACM0 arm | disarm | stats
+    python3 tools/protocol.py --port /dev/ttyACM0 get [name]
+    python3 tools/protocol.py --port /dev/ttyACM0 set <name> <value> [--save]
+
+or, with no --port, decode a capture of the serial stream (file or stdin) into its frames and text lines:
+    python3 tools/protocol.py decode capture.bin
+
+Frames are 0x00 cobs(type seq data... crc8) 0x00, with the log's text lines in between. For the trace dump see
+tools/trace_decode.py, which uses this module.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+GET_STATE = 0x01
+ARM = 0x02
+DISARM = 0x03
+DUMP_TRACE = 0x04
+READ_CONFIG = 0x05
+WRITE_CONFIG = 0x06
+READ_STATS = 0x07
+
+REPLY = 0x80
+TRACE = DUMP_TRACE | REPLY
+ERROR = 0xFF
+
+ERRORS = {1: "unknown request", 2: "bad length", 3: "no such setting", 4: "value out of range",
+          5: "refused in this state", 6: "busy with a trace dump"}
+
+# must match the states in src/states.graph (tools/state_graph.py checks), the INPUT_* bits in include/states.h, and
+# battery_level_t in include/battery.h.
+STATES = [
+    "START_STATE",
+    "WAIT_FOR_BUTTON_PRESS_STATE",
+    "WAIT_FOR_KICKSTAND_DOWN_STATE",
+    "WAIT_FOR_BUTTON_RELEASE_STATE",
+    "ALARM_ARMED_STATE",
+    "ALARM_TRIGGERED_STATE",
+    "WAIT_FOR_KICKSTAND_UP_STATE",
+    "EXIT_DELAY_STATE",
+    "ENTRY_DELAY_STATE",
+]
+NO_STATE = 0xFF
+
+INPUTS = [
+    (1 << 0, "BUTTON"),
+    (1 << 1, "KICKSTAND"),
+    (1 << 2, "TAMPER"),
+    (1 << 3, "SEAT"),
+    (1 << 4, "SIDE_PANEL"),
+    (1 << 5, "STEERING_LOCK"),
+    (1 << 6, "ALARM_LATCHED"),
+    (1 << 7, "STATE_TIMEOUT"),
+]
+
+BATTERY_LEVELS = ["ok", "low", "critical"]
+
+# stat_id_t in include/stats.h.
+COUNTERS = ["boots", "arms", "entry delays", "owner returns", "triggers", "rearms", "silenced"]
+
+# HAL_RESET_* in include/hal.h.
+RESET_CAUSES = [(1 << 0, "power-on"), (1 << 1, "external"), (1 << 2, "brown-out"), (1 << 3, "watchdog")]
+
+
+def state_name(state):
+    if state == NO_STATE:
+        return "-"
+    return STATES[state] if state < len(STATES) else "STATE_%d" % state
+
+
+def input_names(inputs):
+    names = [name for bit, name in INPUTS if inputs & bit]
+    return "|".join(names) if names else "none"
+
+
+def reset_names(cause):
+    names = [name for bit, name in RESET_CAUSES if cause & bit]
+    return "|".join(names) if names else "none"
+
+
+def crc8_ccitt(data, crc=0):
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_at, code = 0, 1
+    for byte in data:
+        if byte == 0:
+            out[code_at] = code
+            code_at, code = len(out), 1
+            out.append(0)
+        else:
+            out.append(byte)
+            code += 1
+    out[code_at] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """None if data isn't valid cobs."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frame(msg_type, seq, data=b""):
+    message = bytes([msg_type, seq]) + bytes(data)
+    return b"\0" + cobs_encode(message + bytes([crc8_ccitt(message)])) + b"\0"
+
+
+class Stream:
+    """splits the serial stream into messages (type, seq, data) and text, the same way the firmware reads it."""
+
+    def __init__(self):
+        self.in_frame = False
+        self.buffer = bytearray()
+        self.text = bytearray()
+
+    def feed(self, data):
+        """yields ("frame", (type, seq, data)) and ("text", line) as they complete. bad frames are skipped."""
+        for byte in data:
+            if not self.in_frame:
+                if byte == 0:
+                    self.in_frame = True
+                    self.buffer.clear()
+                elif byte == ord("\n"):
+                    yield "text", self.text.decode("ascii", "replace")
+                    self.text.clear()
+                elif byte != ord("\r"):
+                    self.text.append(byte)
+            elif byte != 0:
+                self.buffer.append(byte)
+            elif self.buffer:
+                self.in_frame = False
+                message = cobs_decode(bytes(self.buffer))
+                if message and len(message) >= 3 and crc8_ccitt(message[:-1]) == message[-1]:
+                    yield "frame", (message[0], message[1], message[2:-1])
+
+
+def frames(data):
+    """every intact message in a capture, as (type, seq, data)."""
+    return [item for kind, item in Stream().feed(data) if kind == "frame"]
+
+
+class ProtocolError(Exception):
+    pass
+
+
+class Link:
+    def __init__(self, port, baud=115200, timeout=1.0):
+        import serial  # pyserial, only needed when talking to a board directly
+
+        self.port = serial.Serial(port, baud, timeout=0.05)
+        self.timeout = timeout
+        self.stream = Stream()
+        self.seq = 0
+        self.port.reset_input_buffer()
+
+    def close(self):
+        self.port.close()
+
+    def messages(self, seq, until):
+        """yields replies to seq until until(message) is true or nothing arrives within the timeout."""
+        deadline = time.time() + self.timeout
+        while time.time() < deadline:
+            for kind, item in self.stream.feed(self.port.read(256)):
+                if kind != "frame" or item[1] != seq:
+                    continue
+                deadline = time.time() + self.timeout
+                if item[0] == ERROR:
+                    raise ProtocolError(ERRORS.get(item[2][1], "error %d" % item[2][1]))
+                yield item
+                if until(item):
+                    return
+        raise ProtocolError("no reply")
+
+    def request(self, msg_type, data=b""):
+        """sends a request and returns the data of its reply."""
+        self.seq = (self.seq + 1) & 0xFF
+        self.port.write(frame(msg_type, self.seq, data))
+        for _, _, reply in self.messages(self.seq, lambda m: m[0] == msg_type | REPLY):
+            return reply
+
+    def trace(self):
+        """the trace dump's records as {source: [record bytes, ...]}."""
+        self.seq = (self.seq + 1) & 0xFF
+        self.port.write(frame(DUMP_TRACE, self.seq))
+        sources = {}
+
+        def done(message):
+            return message[2][0] == 1 and len(sources[1]) == message[2][1]  # the last eeprom record
+
+        for _, _, data in self.messages(self.seq, done):
+            source, count = data[0], data[1]
+            sources.setdefault(source, [])
+            if count:
+                sources[source].append(data[3:])
+        return sources
+
+    def settings(self):
+        """[(index, name, value)] for every setting."""
+        result = []
+        index = 0
+        while True:
+            try:
+                reply = self.request(READ_CONFIG, bytes([index]))
+            except ProtocolError as e:
+                if str(e) == ERRORS[3]:
+                    return result
+                raise
+            result.append((reply[0], reply[3:].decode("ascii"), struct.unpack_from("<H", reply, 1)[0]))
+            index += 1
+
+
+def parse_state(data):
+    """a GET_STATE reply as a dict. persist_writes is None from firmware that doesn't send it."""
+    state, inputs, persist, battery, uptime = struct.unpack_from("<BBBBI", data)
+    return {"state": state, "inputs": inputs, "persist": persist, "battery": battery, "uptime": uptime,
+            "persist_writes": struct.unpack_from("<H", data, 8)[0] if len(data) >= 10 else None}
+
+
+def parse_stats(data):
+    """the counters of a READ_STATS reply as {name: count}, with "time armed" in seconds."""
+    result = {}
+    if len(data) >= 13:
+        result["time armed"] = struct.unpack_from("<I", data, 9)[0]
+        counts = struct.unpack_from("<%dH" % ((len(data) - 13) // 2), data, 13)
+        for i, count in enumerate(counts):
+            result[COUNTERS[i] if i < len(COUNTERS) else "counter %d" % i] = count
+    return result
+
+
+def print_state(data):
+    state = parse_state(data)
+    print("state    %s" % state_name(state["state"]))
+    print("inputs   %s" % input_names(state["inputs"]))
+    print("persist  0x%02x" % state["persist"])
+    battery = state["battery"]
+    print("battery  %s" % (BATTERY_LEVELS[battery] if battery < len(BATTERY_LEVELS) else battery))
+    print("uptime   %.3f s" % (state["uptime"] / 1000.0))
+    if state["persist_writes"] is not None:
+        print("writes   %u persist records since boot" % state["persist_writes"])
+
+
+def print_stats(data):
+    cause, log_dropped, frames_ok, frames_bad, replies_dropped = struct.unpack_from("<BHHHH", data)
+    print("reset cause      %s" % reset_names(cause))
+    print("log dropped      %u" % log_dropped)
+    print("frames ok / bad  %u / %u" % (frames_ok, frames_bad))
+    print("replies dropped  %u" % replies_dropped)
+    counters = parse_stats(data)
+    if counters:
+        armed_time = counters.pop("time armed")
+        print("time armed       %u h %02u min" % (armed_time // 3600, armed_time // 60 % 60))
+        for name, count in counters.items():
+            print("%-16s %u" % (name, count))
+        if len(counters) >= 7:
+            entry_delays, triggers = counters["entry delays"], counters["triggers"]
+            if entry_delays:
+                print("false alarms     %.0f%% of entry delays cut short"
+                      % (100.0 * counters["owner returns"] / entry_delays))
+            if triggers:
+                print("auto re-arm      %.0f%% of triggers" % (100.0 * counters["rearms"] / triggers))
+
+
+def run(link, args):
+    if args.command == "state":
+        print_state(link.request(GET_STATE))
+    elif args.command in ("arm", "disarm"):
+        reply = link.request(ARM if args.command == "arm" else DISARM)
+        print(state_name(reply[0]))
+    elif args.command == "stats":
+        print_stats(link.request(READ_STATS))
+    elif args.command == "get":
+        for index, name, value in link.settings():
+            if not args.name or name == args.name:
+                print("%s = %u" % (name, value))
+    elif args.command == "set":
+        indices = {name: index for index, name, _ in link.settings()}
+        if args.name not in indices:
+            raise ProtocolError("unknown setting %s" % args.name)
+        reply = link.request(WRITE_CONFIG, struct.pack("<BHB", indices[args.name], args.value, args.save))
+        print("%s = %u%s" % (args.name, struct.unpack_from("<H", reply, 1)[0], ", saved" if args.save else ""))
+
+
+def decode(data):
+    for kind, item in Stream().feed(data):
+        if kind == "text":
+            print(item)
+        else:
+            msg_type, seq, payload = item
+            print("[frame type 0x%02x seq %u: %s]" % (msg_type, seq, payload.hex(" ")))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", help="serial port of the board")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to wait for a reply")
+    commands = parser.add_subparsers(dest="command", required=True)
+    for name in ("state", "arm", "disarm", "stats"):
+        commands.add_parser(name)
+    get = commands.add_parser("get")
+    get.add_argument("name", nargs="?")
+    set_ = commands.add_parser("set")
+    set_.add_argument("name")
+    set_.add_argument("value", type=int)
+    set_.add_argument("--save", action="store_true", help="write the settings to EEPROM too")
+    capture = commands.add_parser("decode")
+    capture.add_argument("capture", nargs="?", help="file with raw serial output, stdin otherwise")
+    args = parser.parse_args()
+
+    if args.command == "decode":
+        if args.capture:
+            with open(args.capture, "rb") as f:
+                decode(f.read())
+        else:
+            decode(sys.stdin.buffer.read())
+        return 0
+    if not args.port:
+        parser.error("--port is needed to talk to a board")
+
+    link = Link(args.port, args.baud, args.timeout)
+    try:
+        run(link, args)
+    except ProtocolError as e:
+        print(e, file=sys.stderr)
+        return 1
+    finally:
+        link.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
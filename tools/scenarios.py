@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Runs the native simulator on every scenario in test/scenarios, one fresh run (blank EEPROM, power on) per file.
+
+Runs after every env:native build as a PlatformIO extra script (see platformio.ini) and fails the build if any
+scenario does. Or by hand, on all of them or just some:
+    python3 tools/scenarios.py
+    python3 tools/scenarios.py --program .pio/build/native/program test/scenarios/rearm.txt
+
+the script language is described in src/native/sim_main.cpp. a scenario fails when one of its expects does, or when
+the simulator can't run it; the failing lines are printed as they come.
+"""
+
+import argparse
+import glob
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SCENARIOS = os.path.join(ROOT, "test", "scenarios", "*.txt")
+PROGRAM = os.path.join(ROOT, ".pio", "build", "native", "program")
+
+
+def run(program, scenarios):
+    """runs each scenario, printing the simulator's summary for it. true if all of them pass."""
+    failed = []
+    for scenario in scenarios:
+        result = subprocess.run([program, scenario], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        lines = result.stderr.splitlines()
+        for line in lines[:-1]:
+            print(line)
+        print("%-32s %s" % (os.path.basename(scenario), lines[-1] if lines else "no output"))
+        if result.returncode != 0:
+            failed.append(os.path.basename(scenario))
+    if failed:
+        print("scenarios failed: %s" % ", ".join(failed), file=sys.stderr)
+    else:
+        print("%u scenarios passed" % len(scenarios))
+    return not failed
+
+
+def platformio_post_build(env):
+    """extra script entry point: runs the scenarios on the program after it's linked."""
+    def check(target, source, env):
+        return 0 if run(target[0].get_abspath(), sorted(glob.glob(SCENARIOS))) else 1
+
+    env.AddPostAction("$PROGPATH", check)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("scenarios", nargs="*", help="scripts to run, all of test/scenarios by default")
+    parser.add_argument("--program", default=PROGRAM, help="the simulator, built by `pio run -e native`")
+    args = parser.parse_args()
+
+    scenarios = args.scenarios or sorted(glob.glob(SCENARIOS))
+    if not scenarios:
+        print("no scenarios in %s" % os.path.dirname(SCENARIOS), file=sys.stderr)
+        return 2
+    return 0 if run(args.program, scenarios) else 1
+
+
+try:
+    Import("env")  # noqa: F821, only defined when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    platformio_post_build(env)  # noqa: F821
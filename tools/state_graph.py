@@ -0,0 +1,546 @@
+#!/usr/bin/env python3
+"""
+Checks the alarm's state graph (src/states.graph) and generates the code for it: include/state_graph.h, the state
+enum, and src/state_tables.h, the PROGMEM tables for state_machine.h that main.cpp includes.
+
+Runs before every build as a PlatformIO extra script (see platformio.ini), regenerating whatever is out of date and
+failing the build if a check doesn't pass. By hand:
+    python3 tools/state_graph.py              check, and regenerate the headers if needed
+    python3 tools/state_graph.py --check      check, and fail if the headers aren't up to date (for ci)
+    python3 tools/state_graph.py --report     also list, per state, the input combinations it waits on
+    python3 tools/state_graph.py --dot states.dot
+                                              a Graphviz drawing ('-' for stdout): dot -Tsvg states.dot -o states.svg
+
+The checks go through every combination of the 8 input bits in every state, which is cheap at 256 x the states:
+  - names: every state, input, stat and action named exists, and every state is declared once.
+  - guards: none sets and clears the same bit, and STATE_TIMEOUT only appears in states marked timeout.
+  - shadowing: every transition is the first match for at least one combination, otherwise it's dead code.
+  - reachability: every state can be reached from the initial one.
+  - dead states: every state has a way out, and every state past the initial one can get back to every other, so
+    nothing traps the machine.
+  - stability: no combination of inputs makes the machine go round a loop of states without an input changing
+    (entering a state stops its timeout, so STATE_TIMEOUT clears along the way).
+  - stats: every counted transition exists in one of the tables.
+  - tools/protocol.py's STATES list matches the enum.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+GRAPH = os.path.join(ROOT, "src", "states.graph")
+ENUM_HEADER = os.path.join(ROOT, "include", "state_graph.h")
+TABLES_HEADER = os.path.join(ROOT, "src", "state_tables.h")
+INPUT_HEADERS = [os.path.join(ROOT, "include", name) for name in ("debounce.h", "states.h")]
+STATS_HEADER = os.path.join(ROOT, "include", "stats.h")
+
+GENERATED = "// generated by tools/state_graph.py from src/states.graph, edit that instead."
+LINE_MAX = 120
+INPUT_COMBINATIONS = 256
+
+
+class GraphError(Exception):
+    pass
+
+
+class State:
+    def __init__(self, name, index, line):
+        self.name = name
+        self.index = index
+        self.line = line
+        self.initial = False
+        self.timeout = False
+        self.throttled = False
+        self.actions = {"enter": None, "event": None, "exit": None}
+        self.comment = []
+
+
+class Transition:
+    def __init__(self, source, target, set_bits, clear_bits, names, line, comment):
+        self.source = source
+        self.target = target
+        self.set_bits = set_bits
+        self.clear_bits = clear_bits
+        self.names = names  # guard as written, e.g. ["BUTTON", "!KICKSTAND"]
+        self.line = line
+        self.comment = comment
+
+    def matches(self, inputs):
+        mask = self.set_bits | self.clear_bits
+        return inputs & mask == self.set_bits
+
+    def where(self):
+        return "states.graph:%d" % self.line
+
+
+class Table:
+    def __init__(self, name, remote, comment):
+        self.name = name
+        self.remote = remote
+        self.comment = comment
+        self.transitions = []
+
+
+class Graph:
+    def __init__(self):
+        self.states = []
+        self.by_name = {}
+        self.tables = []
+        self.stats = []  # (Transition, stat name)
+
+    def main_table(self):
+        return next(table for table in self.tables if not table.remote)
+
+    def initial(self):
+        return next(state for state in self.states if state.initial)
+
+
+def input_bits():
+    """{"BUTTON": 0x01, ...}: the INPUT_* bits, worked out from the #defines in debounce.h and states.h."""
+    defines = {}
+    for path in INPUT_HEADERS:
+        with open(path) as f:
+            for line in f:
+                match = re.match(r"#define\s+(\w+)\s+(.+?)\s*(//.*)?$", line)
+                if match:
+                    defines[match.group(1)] = match.group(2)
+
+    def value(expression, depth=0):
+        if depth > 8:
+            raise GraphError("can't work out %s" % expression)
+        # only ors of _BV(n) and other such defines, which is all the input bits are.
+        total = 0
+        for bit, name in re.findall(r"_BV\((\d+)\)|(\w+)", expression):
+            if bit:
+                total |= 1 << int(bit)
+            elif name in defines:
+                total |= value(defines[name], depth + 1)
+            else:
+                raise GraphError("can't work out %s" % name)
+        return total
+
+    return {name[len("INPUT_"):]: value(defines[name]) for name in defines
+            if name.startswith("INPUT_") and name != "INPUT_SENSORS_AT_REST"}
+
+
+def stat_names():
+    with open(STATS_HEADER) as f:
+        return set(re.findall(r"^\s+STAT_(\w+),", f.read(), re.MULTILINE)) - {"COUNT"}
+
+
+def parse(path, inputs, stats):
+    graph = Graph()
+    table = None
+    in_stats = False
+    comment = []
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    def fail(number, message):
+        raise GraphError("states.graph:%d: %s" % (number, message))
+
+    def state(number, name):
+        if name not in graph.by_name:
+            fail(number, "no such state %s" % name)
+        return graph.by_name[name]
+
+    # the header comment, up to the first blank line, is the file's own.
+    start = 0
+    while start < len(lines) and lines[start].startswith("#"):
+        start += 1
+
+    for number, line in enumerate(lines[start:], start + 1):
+        line = line.strip()
+        if not line:
+            comment = []
+            continue
+        if line.startswith("#"):
+            comment.append(line[1:].strip())
+            continue
+        words = line.split()
+
+        if words[0] == "state":
+            if len(words) < 2:
+                fail(number, "state needs a name")
+            if graph.tables or in_stats:
+                fail(number, "states come before the tables")
+            if words[1] in graph.by_name:
+                fail(number, "%s declared twice" % words[1])
+            s = State(words[1], len(graph.states), number)
+            s.comment = comment
+            i = 2
+            while i < len(words):
+                if words[i] in ("initial", "timeout", "throttled"):
+                    setattr(s, words[i], True)
+                    i += 1
+                elif words[i] in s.actions and i + 1 < len(words):
+                    s.actions[words[i]] = words[i + 1]
+                    i += 2
+                else:
+                    fail(number, "don't know what %s is" % words[i])
+            graph.states.append(s)
+            graph.by_name[s.name] = s
+        elif words[0] == "table":
+            if len(words) not in (2, 3) or (len(words) == 3 and words[2] != "remote"):
+                fail(number, "table <NAME> [remote]")
+            if any(t.name == words[1] for t in graph.tables):
+                fail(number, "table %s declared twice" % words[1])
+            table = Table(words[1], len(words) == 3, comment)
+            graph.tables.append(table)
+            in_stats = False
+        elif words == ["stats"]:
+            in_stats = True
+            table = None
+        elif len(words) >= 3 and words[1] == "->":
+            source, target = state(number, words[0]), state(number, words[2])
+            if in_stats:
+                if len(words) != 5 or words[3] != "count":
+                    fail(number, "<FROM> -> <TO> count <STAT>")
+                if words[4] not in stats:
+                    fail(number, "no such stat STAT_%s in stats.h" % words[4])
+                graph.stats.append((Transition(source, target, 0, 0, [], number, comment), words[4]))
+            else:
+                if table is None:
+                    fail(number, "transition outside a table")
+                set_bits = clear_bits = 0
+                guard = words[3:]
+                if guard:
+                    if guard[0] != "if" or len(guard) < 2:
+                        fail(number, "<FROM> -> <TO> [if <INPUT>|!<INPUT> ...]")
+                    guard = guard[1:]
+                for name in guard:
+                    bit = inputs.get(name.lstrip("!"))
+                    if bit is None:
+                        fail(number, "no such input INPUT_%s" % name.lstrip("!"))
+                    if name.startswith("!"):
+                        clear_bits |= bit
+                    else:
+                        set_bits |= bit
+                if set_bits & clear_bits:
+                    fail(number, "the guard needs an input both set and clear")
+                table.transitions.append(Transition(source, target, set_bits, clear_bits, guard, number, comment))
+        else:
+            fail(number, "can't make sense of this")
+        comment = []
+
+    if not graph.states:
+        raise GraphError("states.graph: no states")
+    if sum(s.initial for s in graph.states) != 1:
+        raise GraphError("states.graph: exactly one state has to be initial")
+    if sum(not t.remote for t in graph.tables) != 1:
+        raise GraphError("states.graph: exactly one table has to be the machine's (not remote)")
+    if len(graph.states) > 16:
+        raise GraphError("states.graph: THROTTLED_STATES only has room for 16 states")
+    return graph
+
+
+def possible(state, inputs, timeout_bit):
+    """whether the combination can happen in state: STATE_TIMEOUT only where the state timer runs."""
+    return state.timeout or not inputs & timeout_bit
+
+
+def first_match(transitions, state, inputs):
+    for t in transitions:
+        if t.source is state and t.matches(inputs):
+            return t
+    return None
+
+
+def settle(transitions, state, inputs, timeout_bit):
+    """follows transitions from state with the inputs held. the states on the way if that never ends, else None."""
+    path = [state.name]
+    visited = {(state, inputs)}
+    while True:
+        t = first_match(transitions, state, inputs)
+        if t is None:
+            return None
+        state, inputs = t.target, inputs & ~timeout_bit
+        path.append(state.name)
+        if (state, inputs) in visited:
+            return path
+        visited.add((state, inputs))
+
+
+def check(graph, inputs):
+    """the list of problems, empty if there are none."""
+    problems = []
+    timeout_bit = inputs["STATE_TIMEOUT"]
+    main = graph.main_table().transitions
+    every = [t for table in graph.tables for t in table.transitions]
+
+    for t in every:
+        if t.set_bits & timeout_bit and not t.source.timeout:
+            problems.append("%s: %s has no state timeout, STATE_TIMEOUT is never set in it" % (t.where(),
+                                                                                              t.source.name))
+
+    # shadowing: within a table, every transition has to be the first to match for some inputs.
+    for table in graph.tables:
+        for t in table.transitions:
+            if not any(possible(t.source, i, timeout_bit) and first_match(table.transitions, t.source, i) is t
+                       for i in range(INPUT_COMBINATIONS)):
+                problems.append("%s: %s -> %s is never taken, the transitions before it in %s always match first"
+                                % (t.where(), t.source.name, t.target.name, table.name))
+
+    # reachability over every table, remote ones included.
+    edges = {s: set() for s in graph.states}
+    for t in every:
+        edges[t.source].add(t.target)
+    initial = graph.initial()
+
+    def reachable(start):
+        seen = {start}
+        todo = [start]
+        while todo:
+            for target in edges[todo.pop()]:
+                if target not in seen:
+                    seen.add(target)
+                    todo.append(target)
+        return seen
+
+    from_initial = reachable(initial)
+    for s in graph.states:
+        if s not in from_initial:
+            problems.append("%s is unreachable from %s" % (s.name, initial.name))
+
+    # dead states: no way out, or no way back to the rest of the graph.
+    later = [s for s in graph.states if s is not initial and s in from_initial]
+    for s in graph.states:
+        if not edges[s]:
+            problems.append("%s has no transitions out of it: once in, the machine stays there" % s.name)
+    for s in later:
+        missing = [other.name for other in later if other not in reachable(s)]
+        if edges[s] and missing:
+            problems.append("%s can't get back to %s" % (s.name, ", ".join(missing)))
+
+    # stability: from every state and combination, follow the machine's table with the inputs held still.
+    for s in graph.states:
+        for i in range(INPUT_COMBINATIONS):
+            if possible(s, i, timeout_bit):
+                loop = settle(main, s, i, timeout_bit)
+                if loop:
+                    problems.append("inputs 0x%02x go round %s without changing" % (i, " -> ".join(loop)))
+                    break  # one report per starting state is enough
+
+    for t, stat in graph.stats:
+        if not any(u.source is t.source and u.target is t.target for u in every):
+            problems.append("%s: STAT_%s counts %s -> %s, which no table has" % (t.where(), stat, t.source.name,
+                                                                                 t.target.name))
+
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import protocol
+    if protocol.STATES != [s.name for s in graph.states]:
+        problems.append("tools/protocol.py's STATES doesn't match the states in states.graph")
+    return problems
+
+
+def waits(graph, inputs):
+    """{state: number of possible input combinations where no transition of the machine's table matches}"""
+    timeout_bit = inputs["STATE_TIMEOUT"]
+    main = graph.main_table().transitions
+    result = {}
+    for s in graph.states:
+        combos = [i for i in range(INPUT_COMBINATIONS) if possible(s, i, timeout_bit)]
+        result[s] = (sum(first_match(main, s, i) is None for i in combos), len(combos))
+    return result
+
+
+def comment_lines(comment, indent):
+    return ["%s// %s" % (indent, line) if line else indent + "//" for line in comment]
+
+
+def guard(t):
+    names = lambda bits: " | ".join("INPUT_" + n.lstrip("!") for n in t.names if bool(n.startswith("!")) != bits)
+    if not t.names:
+        return "0, 0"
+    if not t.clear_bits:
+        return "WHEN_SET(%s)" % names(True)
+    if not t.set_bits:
+        return "WHEN_CLEAR(%s)" % names(False)
+    return "WHEN(%s, %s)" % (names(True), names(False))
+
+
+def with_comment(row, comment, indent):
+    """row with its comment trailing if it's a line that fits, above it otherwise."""
+    if len(comment) == 1 and len(indent + row + " // " + comment[0]) <= LINE_MAX:
+        return [indent + row + " // " + comment[0]]
+    return comment_lines(comment, indent) + [indent + row]
+
+
+def enum_header(graph):
+    lines = [GENERATED, "#ifndef STATE_GRAPH_H", "#define STATE_GRAPH_H", "", '#include "state_machine.h"', "",
+             "/**",
+             " * the alarm's states, in the order of src/states.graph. STATE_GRAPH_STATES(X) is X(name) for each of",
+             " * them, for tables that need an entry per state.",
+             " */",
+             "#define STATE_GRAPH_STATES(X) \\"]
+    lines += ["    X(%s)%s" % (s.name, " \\" if s is not graph.states[-1] else "") for s in graph.states]
+    lines += ["", "enum : state_t {"]
+    lines += ["    %s," % s.name for s in graph.states]
+    lines += ["    STATE_COUNT", "};", "", "#endif //STATE_GRAPH_H"]
+    return "\n".join(lines) + "\n"
+
+
+def tables_header(graph):
+    indent = " " * 8
+    lines = [GENERATED, "// only main.cpp includes this, after the state actions.", "",
+             "#ifndef STATE_TABLES_H", "#define STATE_TABLES_H", "", '#include "states.h"', '#include "stats.h"']
+
+    for table in graph.tables:
+        lines.append("")
+        transitions = table.transitions
+        if not table.remote:
+            transitions = sorted(transitions, key=lambda t: t.source.index)  # stable, keeps the order in a group
+            lines += ["/**", " * TRANSITIONS. grouped by from-state, and checked in order within each group (the first"
+                      " match wins).", " */"]
+        lines += comment_lines(table.comment, "")
+        lines.append("constexpr transition_def_t %s[] PROGMEM = {" % table.name)
+        for n, t in enumerate(transitions):
+            if t.comment and n:
+                lines.append("")
+            lines += comment_lines(t.comment, indent)
+            lines.append("%s{%s, %s, %s}," % (indent, t.source.name, t.target.name, guard(t)))
+        lines.append("};")
+        if not table.remote:
+            lines += ["", "static_assert(sm_sorted(%s, sizeof(%s) / sizeof(transition_def_t))," % ((table.name,) * 2),
+                      '              "%s must be grouped by from-state");' % table.name]
+
+    lines += ["", "/**", " * STATISTICS. the transitions that bump a counter (see stats.h), in any order.", " */",
+              "struct stat_transition_t {", "    state_t from;", "    state_t to;", "    uint8_t stat;", "};", "",
+              "constexpr stat_transition_t STAT_TRANSITIONS[] PROGMEM = {"]
+    for t, stat in graph.stats:
+        lines += with_comment("{%s, %s, STAT_%s}," % (t.source.name, t.target.name, stat), t.comment, indent)
+    lines.append("};")
+
+    main = graph.main_table().name
+    lines += ["", "/**", " * STATES. indexed by state_t, so the order has to match the enum.", " */",
+              "constexpr state_def_t STATES[] PROGMEM = {"]
+    for s in graph.states:
+        args = [main, s.name] + [s.actions[a] or "nullptr" for a in ("enter", "event", "exit")]
+        row = "STATE_DEF(%s)," % ", ".join(args)
+        if len(indent + row) > LINE_MAX:
+            row = "STATE_DEF(%s,\n%s%s)," % (", ".join(args[:4]), indent + " " * len("STATE_DEF("), args[4])
+        lines += with_comment(row, s.comment, indent) if "\n" not in row else comment_lines(s.comment, indent) + [
+            indent + row]
+    lines += ["};", "",
+              'static_assert(sizeof(STATES) / sizeof(state_def_t) == STATE_COUNT, "STATES needs one entry per state");']
+
+    throttled = " | ".join("_BV(%s)" % s.name for s in graph.states if s.throttled) or "0"
+    lines += ["", "// states that spend their time waiting on a switch or the motion sensor, which the cpu can do at a "
+                  "fraction of its", "// clock (see power_throttle()). the rest run at full speed from the moment "
+                  "they are entered.",
+              "static const uint16_t THROTTLED_STATES = %s;" % throttled, "", "#endif //STATE_TABLES_H"]
+    return "\n".join(lines) + "\n"
+
+
+def dot(graph):
+    lines = ["// %s" % GENERATED[3:], "digraph states {", '    rankdir=LR;',
+             '    node [shape=box, style=rounded, fontname="Helvetica"];',
+             '    edge [fontname="Helvetica", fontsize=10];']
+    for s in graph.states:
+        attributes = []
+        if s.initial:
+            attributes.append("peripheries=2")
+        if s.throttled:
+            attributes.append('style="rounded,filled", fillcolor="#e8f0ff"')
+        if s.timeout:
+            attributes.append('xlabel="timeout"')
+        lines.append("    %s%s;" % (s.name, " [%s]" % ", ".join(attributes) if attributes else ""))
+    counted = {(t.source, t.target): stat for t, stat in graph.stats}
+    for table in graph.tables:
+        for t in table.transitions:
+            label = " ".join(t.names) or "always"
+            if table.remote:
+                label = "%s: %s" % (table.name.replace("_TRANSITIONS", "").lower(), label)
+            stat = counted.get((t.source, t.target))
+            if stat:
+                label += "\\n[%s]" % stat.lower()
+            style = ', style=dashed, color="#707070"' if table.remote else ""
+            lines.append('    %s -> %s [label="%s"%s];' % (t.source.name, t.target.name, label, style))
+    lines.append("}")
+    return "\n".join(lines) + "\n"
+
+
+def load():
+    inputs = input_bits()
+    graph = parse(GRAPH, inputs, stat_names())
+    return graph, inputs
+
+
+def stale(outputs):
+    """the outputs whose file doesn't have the content it should."""
+    result = []
+    for path, content in outputs:
+        try:
+            with open(path) as f:
+                if f.read() == content:
+                    continue
+        except OSError:
+            pass
+        result.append(path)
+    return result
+
+
+def generate(update=True):
+    """checks the graph and regenerates the headers. returns the problems, empty if all is well."""
+    try:
+        graph, inputs = load()
+    except GraphError as e:
+        return [str(e)]
+    problems = check(graph, inputs)
+    if problems:
+        return problems
+    outputs = [(ENUM_HEADER, enum_header(graph)), (TABLES_HEADER, tables_header(graph))]
+    for path in stale(outputs):
+        if not update:
+            problems.append("%s is out of date, run tools/state_graph.py" % os.path.relpath(path, ROOT))
+            continue
+        with open(path, "w") as f:
+            f.write(dict(outputs)[path])
+        print("state_graph: wrote %s" % os.path.relpath(path, ROOT))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--check", action="store_true", help="don't write anything, fail if the headers are stale")
+    parser.add_argument("--report", action="store_true", help="list the input combinations each state waits on")
+    parser.add_argument("--dot", help="write a Graphviz drawing here, - for stdout")
+    args = parser.parse_args()
+
+    problems = generate(update=not args.check)
+    for problem in problems:
+        print(problem, file=sys.stderr)
+    if problems:
+        return 1
+
+    graph, inputs = load()
+    if args.report:
+        for s, (waiting, possible_count) in waits(graph, inputs).items():
+            print("%-32s waits on %3u of %3u input combinations" % (s.name, waiting, possible_count))
+    if args.dot:
+        if args.dot == "-":
+            sys.stdout.write(dot(graph))
+        else:
+            with open(args.dot, "w") as f:
+                f.write(dot(graph))
+    return 0
+
+
+def platformio_pre_build(env):
+    """extra script entry point: brings the headers up to date before anything is compiled."""
+    problems = generate()
+    if problems:
+        for problem in problems:
+            print(problem, file=sys.stderr)
+        env.Exit(1)
+
+
+try:
+    Import("env")  # noqa: F821, only defined when PlatformIO runs this as an extra script
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
+else:
+    platformio_pre_build(env)  # noqa: F821
@@ -0,0 +1,323 @@
+#!/usr/bin/env python3
+"""
+Stress tests for a unit wired to the rig (src/rig/rig.cpp, env:rig), which works its switches. Talks to the rig and to
+the unit itself (through tools/protocol.py), so both usb ports are needed, and pyserial.
+
+    python3 tools/stress_rig.py --rig /dev/ttyACM1 --unit /dev/ttyACM0 storm [--rounds 20] [--edges 2000]
+    python3 tools/stress_rig.py --rig /dev/ttyACM1 --unit /dev/ttyACM0 endurance [--cycles 1000] [--trigger-every 10]
+
+storm: arms the unit and chatters the kickstand with switch bounce shorter than the debounce time, ending down, which
+must not start the entry delay. then the same ending up, a real lift, which must sound the siren: its latency is
+timed by the rig from the last edge. the alarm is silenced with chatter on the kickstand as well.
+
+endurance: park / unpark cycles, arming and riding off the way the owner does, with a trigger and silence every
+--trigger-every cycles and optional chatter (--chatter) on every kickstand move.
+
+The exit and entry delays are set to 0 for the run (not saved) and put back afterwards. Every run prints a summary:
+the unit's stat counters and persist writes over the run (see include/stats.h, include/persist.h), trigger latencies,
+and what went wrong. --results appends it to a file as one line of JSON, for tracking across firmware versions. The
+exit status is 1 if a trigger was missed, chatter got through, or the unit didn't follow.
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import protocol  # noqa: E402
+
+RIG_BAUD = 115200
+
+STATES = {name: i for i, name in enumerate(protocol.STATES)}
+
+
+class RigError(Exception):
+    pass
+
+
+class Rig:
+    def __init__(self, port, timeout=1.0):
+        import serial  # pyserial
+
+        self.port = serial.Serial(port, RIG_BAUD, timeout=timeout)
+        self.timeout = timeout
+        self.closed = {}  # where the rig has left each switch
+        self.port.reset_input_buffer()
+
+    def close(self):
+        self.port.close()
+
+    def command(self, line, duration=0.0):
+        """sends a command and returns the numbers of its ok reply. duration: how long it will take, on top of the
+        timeout."""
+        self.port.write((line + "\n").encode("ascii"))
+        deadline = time.time() + duration + self.timeout
+        while time.time() < deadline:
+            reply = self.port.readline().decode("ascii", "replace").strip()
+            if reply.startswith("ok"):
+                return [int(word) for word in reply.split()[1:]]
+            if reply.startswith("error"):
+                raise RigError("%s: %s" % (line, reply[6:]))
+        raise RigError("%s: no reply from the rig" % line)
+
+    def set(self, switch, closed):
+        self.command("%s %s" % ("close" if closed else "open", switch))
+        self.closed[switch] = closed
+
+    def storm(self, switch, edges, min_us, max_us):
+        self.command("storm %s %d %d %d" % (switch, edges, min_us, max_us), edges * max_us / 1e6)
+        self.closed[switch] = self.closed.get(switch, False) != bool(edges & 1)
+
+    def watch(self, timeout_ms):
+        """us from the rig's last edge until the siren started, None if it didn't within timeout_ms."""
+        try:
+            return self.command("watch %d" % timeout_ms, timeout_ms / 1000.0)[0]
+        except RigError as e:
+            if str(e).endswith("timeout"):
+                return None
+            raise
+
+
+class Run:
+    """one test run against the unit: its settings, how it's doing, and the tally."""
+
+    def __init__(self, rig, unit, args):
+        self.rig = rig
+        self.unit = unit
+        self.args = args
+        self.failures = []
+        self.latencies = []
+        self.saved = {}
+
+        self.settings = {name: (index, value) for index, name, value in unit.settings()}
+        self.debounce_ms = self.settings["debounce_samples"][1]
+
+    def setting(self, name, value):
+        index, _ = self.settings[name]
+        self.unit.request(protocol.WRITE_CONFIG, bytes([index, value & 0xFF, value >> 8, 0]))
+
+    def start(self):
+        for name in ("exit_delay", "entry_delay"):
+            self.saved[name] = self.settings[name][1]
+            self.setting(name, 0)
+
+        # sensors at rest, in case they're fitted: side panel in place, steering lock engaged.
+        for switch, closed in (("button", False), ("kickstand", False), ("seat", False), ("panel", True),
+                               ("lock", True)):
+            self.rig.set(switch, closed)
+        self.settle()
+        if self.state() != STATES["WAIT_FOR_BUTTON_PRESS_STATE"]:
+            self.recover()
+
+        self.begin_state = protocol.parse_state(self.unit.request(protocol.GET_STATE))
+        self.begin_stats = protocol.parse_stats(self.unit.request(protocol.READ_STATS))
+        self.begin_time = time.time()
+
+    def finish(self):
+        for name, value in self.saved.items():
+            self.setting(name, value)
+
+    def state(self):
+        return protocol.parse_state(self.unit.request(protocol.GET_STATE))["state"]
+
+    def wait_state(self, name, timeout=None):
+        """waits for the unit to get to state name. false, and a failure noted, if it doesn't."""
+        deadline = time.time() + (timeout or self.args.state_timeout)
+        while True:
+            state = self.state()
+            if state == STATES[name]:
+                return True
+            if time.time() >= deadline:
+                self.failures.append("stuck in %s waiting for %s" % (protocol.state_name(state), name))
+                return False
+            time.sleep(0.02)
+
+    def settle(self):
+        """time for the debouncer to take a change, and the unit to act on it."""
+        time.sleep(self.debounce_ms / 1000.0 + 0.05)
+
+    def move(self, switch, closed):
+        """moves a switch, through chatter if asked for. an odd number of edges ends up at the new position."""
+        if self.rig.closed.get(switch) == closed:
+            return
+        if self.args.chatter:
+            self.rig.storm(switch, self.args.chatter | 1, self.args.min_us, self.max_us())
+        else:
+            self.rig.set(switch, closed)
+        self.settle()
+
+    def max_us(self):
+        # bounce has to stay well inside the debounce time to be filtered out.
+        return self.args.max_us or self.debounce_ms * 500
+
+    def arm(self):
+        self.move("kickstand", True)
+        self.rig.set("button", True)
+        self.settle()
+        self.rig.set("button", False)
+        self.settle()
+        return self.wait_state("ALARM_ARMED_STATE")
+
+    def ride_off(self):
+        """the owner's way out of armed: button held, kickstand up, button let go."""
+        self.rig.set("button", True)
+        self.settle()
+        self.move("kickstand", False)
+        self.rig.set("button", False)
+        self.settle()
+        return self.wait_state("WAIT_FOR_BUTTON_PRESS_STATE")
+
+    def lift(self, edges):
+        """lifts the kickstand of an armed bike, through edges of chatter, and times the siren."""
+        if edges:
+            self.rig.storm("kickstand", edges | 1, self.args.min_us, self.max_us())
+        else:
+            self.rig.set("kickstand", False)
+        latency = self.rig.watch(self.debounce_ms + self.args.siren_timeout)
+        if latency is None:
+            self.failures.append("no siren after the kickstand went up")
+            return False
+        self.latencies.append(latency)
+        return self.wait_state("ALARM_TRIGGERED_STATE")
+
+    def silence(self):
+        """kickstand down, button, kickstand up (through chatter on the way), button let go."""
+        self.move("kickstand", True)
+        self.rig.set("button", True)
+        self.settle()
+        if not self.wait_state("WAIT_FOR_KICKSTAND_UP_STATE"):
+            return False
+        self.move("kickstand", False)
+        self.rig.set("button", False)
+        self.settle()
+        return self.wait_state("WAIT_FOR_BUTTON_PRESS_STATE")
+
+    def recover(self):
+        """back to disarmed after a failure, the long way if need be."""
+        self.rig.set("button", False)
+        self.settle()
+        state = self.state()
+        if state in (STATES["ALARM_TRIGGERED_STATE"], STATES["WAIT_FOR_KICKSTAND_UP_STATE"]):
+            self.silence()
+        elif state != STATES["WAIT_FOR_BUTTON_PRESS_STATE"]:
+            try:
+                self.unit.request(protocol.DISARM)
+            except protocol.ProtocolError:
+                pass
+            self.move("kickstand", False)
+            self.wait_state("WAIT_FOR_BUTTON_PRESS_STATE")
+
+    def storm_round(self):
+        if not self.arm():
+            return False
+        self.rig.storm("kickstand", self.args.edges & ~1, self.args.min_us, self.max_us())
+        self.settle()
+        if self.state() != STATES["ALARM_ARMED_STATE"]:
+            self.failures.append("kickstand chatter ending down left armed (%s)" % protocol.state_name(self.state()))
+            return False
+        return self.lift(self.args.edges) and self.silence()
+
+    def endurance_cycle(self, cycle):
+        if not self.arm():
+            return False
+        if self.args.trigger_every and (cycle + 1) % self.args.trigger_every == 0:
+            return self.lift(self.args.chatter) and self.silence()
+        return self.ride_off()
+
+    def report(self, test, count):
+        end_state = protocol.parse_state(self.unit.request(protocol.GET_STATE))
+        end_stats = protocol.parse_stats(self.unit.request(protocol.READ_STATS))
+        writes = None
+        if end_state["persist_writes"] is not None and self.begin_state["persist_writes"] is not None:
+            writes = (end_state["persist_writes"] - self.begin_state["persist_writes"]) & 0xFFFF
+        latencies = sorted(self.latencies)
+        result = {
+            "test": test,
+            "time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+            "args": {k: v for k, v in vars(self.args).items() if k not in ("rig", "unit", "results", "command")},
+            "count": count,
+            "seconds": round(time.time() - self.begin_time, 1),
+            "counters": {name: end_stats[name] - self.begin_stats.get(name, 0) for name in end_stats
+                         if name != "time armed"},
+            "persist_writes": writes,
+            "persist_writes_per_count": round(writes / count, 2) if writes is not None and count else None,
+            "latency_us": {"min": latencies[0], "median": latencies[len(latencies) // 2],
+                           "max": latencies[-1]} if latencies else None,
+            "failures": self.failures,
+        }
+        return result
+
+
+def print_result(result):
+    print("%s: %u in %.0f s" % (result["test"], result["count"], result["seconds"]))
+    for name, delta in result["counters"].items():
+        print("  %-16s +%u" % (name, delta))
+    if result["persist_writes"] is not None:
+        print("  persist writes   +%u (%.2f each)" % (result["persist_writes"], result["persist_writes_per_count"]))
+    if result["latency_us"]:
+        print("  siren latency    %(min)u / %(median)u / %(max)u us (min / median / max)" % result["latency_us"])
+    for failure in result["failures"]:
+        print("  FAILED: %s" % failure)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rig", required=True, help="serial port of the rig")
+    parser.add_argument("--unit", required=True, help="serial port of the unit under test")
+    parser.add_argument("--results", help="append the result to this file, as a line of JSON")
+    parser.add_argument("--seed", type=int, default=1, help="for the rig's random bounce times")
+    parser.add_argument("--min-us", type=int, default=100, help="shortest bounce, us")
+    parser.add_argument("--max-us", type=int, default=0, help="longest bounce, us. default half the debounce time")
+    parser.add_argument("--chatter", type=int, default=0, help="bounce edges on every kickstand move, 0 for none")
+    parser.add_argument("--state-timeout", type=float, default=2.0, help="seconds for the unit to change state")
+    parser.add_argument("--siren-timeout", type=int, default=1000, help="ms for the siren after the debounce time")
+    parser.add_argument("--stop-on-failure", action="store_true")
+    commands = parser.add_subparsers(dest="command", required=True)
+    storm = commands.add_parser("storm")
+    storm.add_argument("--rounds", type=int, default=20)
+    storm.add_argument("--edges", type=int, default=2000, help="edges per storm")
+    endurance = commands.add_parser("endurance")
+    endurance.add_argument("--cycles", type=int, default=1000)
+    endurance.add_argument("--trigger-every", type=int, default=10, help="0 for no triggers")
+    args = parser.parse_args()
+
+    rig = Rig(args.rig)
+    unit = protocol.Link(args.unit)
+    run = None
+    try:
+        rig.command("seed %d" % args.seed)
+        run = Run(rig, unit, args)
+        run.start()
+        count = args.rounds if args.command == "storm" else args.cycles
+        done = 0
+        for i in range(count):
+            ok = run.storm_round() if args.command == "storm" else run.endurance_cycle(i)
+            done += 1
+            if not ok:
+                if args.stop_on_failure:
+                    break
+                run.recover()
+        result = run.report(args.command, done)
+    except (RigError, protocol.ProtocolError) as e:
+        print(e, file=sys.stderr)
+        return 1
+    finally:
+        if run:
+            try:
+                run.finish()
+            except (RigError, protocol.ProtocolError):
+                pass
+        rig.close()
+        unit.close()
+
+    print_result(result)
+    if args.results:
+        with open(args.results, "a") as f:
+            f.write(json.dumps(result) + "\n")
+    return 1 if result["failures"] else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
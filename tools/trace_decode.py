@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+Decodes the binary transition trace (src/trace.cpp), as sent by the protocol's DUMP_TRACE (include/protocol.h), into
+a timeline.
+
+Either ask a connected board for a dump (needs pyserial):
+    python3 tools/trace_decode.py --port /dev/ttyACM0
+or decode a capture of the serial stream (sending T to the console dumps it too):
+    python3 tools/trace_decode.py capture.bin
+
+Each record comes in a TRACE frame, source count index record, with 7 byte little endian records (uint32 micros,
+from-state, to-state, inputs). Log lines between the frames are skipped.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import protocol  # noqa: E402
+
+SOURCES = {0: "ram", 1: "eeprom"}
+
+RECORD = struct.Struct("<IBBB")
+
+
+def parse_frames(data):
+    """yields (source, [(time_us, from, to, inputs), ...]) for every source with a complete dump in data."""
+    records = {}
+    for msg_type, _, payload in protocol.frames(data):
+        if msg_type != protocol.TRACE or len(payload) < 2 or payload[0] not in SOURCES:
+            continue
+        source, count = payload[0], payload[1]
+        if count == 0:
+            yield source, []
+            continue
+        if len(payload) != 3 + RECORD.size:
+            continue
+        index = payload[2]
+        if index == 0:
+            records[source] = []
+        if source in records and len(records[source]) == index:
+            records[source].append(RECORD.unpack_from(payload, 3))
+            if index == count - 1:
+                yield source, records.pop(source)
+
+
+def print_timeline(source, records):
+    print("%s trace, %d transitions" % (SOURCES[source], len(records)))
+    if not records:
+        return
+
+    # micros() wraps every ~71.6 minutes. the records are in order, so unwrap by counting backwards steps.
+    offset = 0
+    previous = records[0][0]
+    start = previous
+    for time_us, from_state, to_state, inputs in records:
+        if time_us < previous:
+            offset += 1 << 32
+        previous = time_us
+        t = (time_us + offset - start) / 1000.0
+        print("  %+12.3f ms  %-30s -> %-30s inputs=%s"
+              % (t, protocol.state_name(from_state), protocol.state_name(to_state), protocol.input_names(inputs)))
+
+
+def read_port(port, baud, timeout):
+    link = protocol.Link(port, baud, timeout)
+    try:
+        sources = link.trace()
+    finally:
+        link.close()
+    for source in sorted(sources):
+        yield source, [RECORD.unpack(record) for record in sources[source]]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="file with raw serial output containing trace frames")
+    parser.add_argument("--port", help="serial port of the board to request a dump from")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=1.0, help="seconds to listen for the dump")
+    args = parser.parse_args()
+
+    if args.port:
+        dumps = read_port(args.port, args.baud, args.timeout)
+    elif args.capture:
+        with open(args.capture, "rb") as f:
+            dumps = parse_frames(f.read())
+    else:
+        dumps = parse_frames(sys.stdin.buffer.read())
+
+    found = False
+    for source, records in dumps:
+        found = True
+        print_timeline(source, records)
+    if not found:
+        print("no trace frames found", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())